@@ -0,0 +1,46 @@
+#include <iomanip>
+#include <string_view>
+
+#include "benchmark.h"
+
+using namespace std::literals;
+
+namespace {
+
+void PrintJsonString(std::ostream& output, std::string_view str) {
+    output << '"';
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            output << '\\';
+        }
+        output << c;
+    }
+    output << '"';
+}
+
+} // namespace
+
+void PrintBenchmarkResultsJson(std::ostream& output, const std::vector<BenchmarkResult>& results) {
+    output << std::fixed << std::setprecision(3);
+    output << "{\n  \"benchmarks\": ["sv;
+
+    bool is_first = true;
+    for (const BenchmarkResult& result : results) {
+        output << (is_first ? "\n"sv : ",\n"sv) << "    {\"name\": "sv;
+        PrintJsonString(output, result.name);
+        for (const auto& [param, value] : result.params) {
+            output << ", "sv;
+            PrintJsonString(output, param);
+            output << ": "sv << value;
+        }
+        output << ", \"operations\": "sv << result.operations
+               << ", \"total_ns\": "sv << result.total_ns
+               << ", \"ns_per_op\": "sv << result.ns_per_op
+               << ", \"ops_per_second\": "sv << result.ops_per_second
+               << ", \"allocations_per_op\": "sv << result.allocations_per_op
+               << ", \"bytes_per_op\": "sv << result.bytes_per_op << '}';
+        is_first = false;
+    }
+
+    output << "\n  ]\n}"sv << std::endl;
+}
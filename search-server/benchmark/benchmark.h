@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// счетчики глобальных operator new; определяются в том translation unit, где operator new подменен
+struct AllocationStats {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+AllocationStats GetAllocationStats();
+
+using BenchmarkParams = std::vector<std::pair<std::string, int>>;
+
+struct BenchmarkResult {
+    std::string name;
+    BenchmarkParams params;
+    uint64_t operations = 0;
+    uint64_t total_ns = 0;
+    double ns_per_op = 0;
+    double ops_per_second = 0;
+    double allocations_per_op = 0;
+    double bytes_per_op = 0;
+};
+
+// замеряет один прогон func, выполняющий operations операций; подготовку состояния делайте до вызова
+template <typename Func>
+BenchmarkResult RunBenchmark(std::string name, BenchmarkParams params, uint64_t operations, Func func) {
+    using Clock = std::chrono::steady_clock;
+
+    const AllocationStats allocations_before = GetAllocationStats();
+    const auto start_time = Clock::now();
+
+    func();
+
+    const auto end_time = Clock::now();
+    const AllocationStats allocations_after = GetAllocationStats();
+
+    BenchmarkResult result;
+    result.name = std::move(name);
+    result.params = std::move(params);
+    result.operations = operations;
+    result.total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+    if (operations > 0) {
+        result.ns_per_op = static_cast<double>(result.total_ns) / operations;
+        result.allocations_per_op = static_cast<double>(allocations_after.count - allocations_before.count) / operations;
+        result.bytes_per_op = static_cast<double>(allocations_after.bytes - allocations_before.bytes) / operations;
+    }
+    if (result.total_ns > 0) {
+        result.ops_per_second = operations * 1e9 / result.total_ns;
+    }
+
+    return result;
+}
+
+// {"benchmarks": [{"name": ..., <params>..., "operations": ..., "ns_per_op": ..., ...}, ...]}
+void PrintBenchmarkResultsJson(std::ostream& output, const std::vector<BenchmarkResult>& results);
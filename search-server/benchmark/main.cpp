@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "../search_server.h"
+#include "../numa_executor.h"
+#include "../process_queries.h"
+#include "../random_data.h"
+
+using namespace std;
+
+// ---------- подсчет аллокаций: подменяем глобальные operator new/delete ----------
+
+// GCC видит free в паре с operator new после инлайна и ложно считает их несогласованными
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+namespace {
+atomic<uint64_t> allocation_count{0};
+atomic<uint64_t> allocation_bytes{0};
+} // namespace
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, memory_order_relaxed);
+    allocation_bytes.fetch_add(size, memory_order_relaxed);
+    if (void* ptr = malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+AllocationStats GetAllocationStats() {
+    return {allocation_count.load(memory_order_relaxed), allocation_bytes.load(memory_order_relaxed)};
+}
+
+// ---------- параметры запуска ----------
+
+struct BenchmarkConfig {
+    vector<int> document_counts = {1'000, 10'000};
+    vector<int> vocabulary_sizes = {1'000, 10'000};
+    int query_count = 1'000;
+    int words_in_document = 30;
+    int words_in_query = 7;
+    string output_path; // пусто -- в stdout
+};
+
+vector<int> ParseIntList(const string& text) {
+    vector<int> result;
+    istringstream input(text);
+    for (string item; getline(input, item, ',');) {
+        result.push_back(stoi(item));
+    }
+    return result;
+}
+
+BenchmarkConfig ParseArguments(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        const auto eq_pos = arg.find('=');
+        const string key = arg.substr(0, eq_pos);
+        const string value = eq_pos == string::npos ? ""s : arg.substr(eq_pos + 1);
+
+        if (key == "--documents"s) {
+            config.document_counts = ParseIntList(value);
+        } else if (key == "--vocabulary"s) {
+            config.vocabulary_sizes = ParseIntList(value);
+        } else if (key == "--queries"s) {
+            config.query_count = stoi(value);
+        } else if (key == "--document-words"s) {
+            config.words_in_document = stoi(value);
+        } else if (key == "--query-words"s) {
+            config.words_in_query = stoi(value);
+        } else if (key == "--output"s) {
+            config.output_path = value;
+        } else {
+            throw invalid_argument("Unknown argument "s + arg);
+        }
+    }
+    return config;
+}
+
+// ---------- сами замеры ----------
+
+struct Corpus {
+    vector<string> dictionary;
+    vector<string> documents;
+    vector<string> queries;
+    vector<string> typo_queries; // те же запросы, но в каждом слове одна буква заменена
+    string match_query;
+};
+
+string MakeTypos(mt19937& generator, string query) {
+    uniform_int_distribution<int> letter_distribution('a', 'z');
+    size_t word_begin = 0;
+    while (word_begin < query.size()) {
+        const size_t word_end = min(query.find(' ', word_begin), query.size());
+        if (word_end > word_begin) {
+            uniform_int_distribution<size_t> position_distribution(word_begin, word_end - 1);
+            query[position_distribution(generator)] = static_cast<char>(letter_distribution(generator));
+        }
+        word_begin = word_end + 1;
+    }
+    return query;
+}
+
+Corpus MakeCorpus(const BenchmarkConfig& config, int document_count, int vocabulary_size) {
+    mt19937 generator;
+    Corpus corpus;
+    corpus.dictionary = GenerateDictionary(generator, vocabulary_size, 10);
+    corpus.documents = GenerateQueries(generator, corpus.dictionary, document_count, config.words_in_document);
+    corpus.queries = GenerateQueries(generator, corpus.dictionary, config.query_count, config.words_in_query);
+    for (const string& query : corpus.queries) {
+        corpus.typo_queries.push_back(MakeTypos(generator, query));
+    }
+    corpus.match_query = GenerateQuery(generator, corpus.dictionary, config.words_in_query * 10, 0.1);
+    return corpus;
+}
+
+void FillServer(SearchServer& search_server, const Corpus& corpus) {
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        search_server.AddDocument(i, corpus.documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+}
+
+template <typename ExecutionPolicy>
+BenchmarkResult BenchmarkFindTopDocuments(string name, const BenchmarkParams& params, const SearchServer& search_server,
+                                          const vector<string>& queries, ExecutionPolicy policy) {
+    double total_relevance = 0;
+    BenchmarkResult result = RunBenchmark(move(name), params, queries.size(), [&] {
+        for (const string& query : queries) {
+            for (const Document& document : search_server.FindTopDocuments(policy, query)) {
+                total_relevance += document.relevance;
+            }
+        }
+    });
+    // не даем компилятору выбросить вычисления
+    cerr << result.name << " checksum: "sv << total_relevance << endl;
+    return result;
+}
+
+BenchmarkResult BenchmarkPreparedQueries(string name, const BenchmarkParams& params, const SearchServer& search_server, const vector<string>& queries) {
+    // запросы разбираются один раз, вне замера -- как у сервиса с повторяющимися запросами
+    vector<SearchServer::PreparedQuery> prepared_queries;
+    prepared_queries.reserve(queries.size());
+    for (const string& query : queries) {
+        prepared_queries.push_back(search_server.PrepareQuery(query));
+    }
+
+    double total_relevance = 0;
+    BenchmarkResult result = RunBenchmark(move(name), params, queries.size(), [&] {
+        for (const SearchServer::PreparedQuery& query : prepared_queries) {
+            for (const Document& document : search_server.FindTopDocuments(query)) {
+                total_relevance += document.relevance;
+            }
+        }
+    });
+    cerr << result.name << " checksum: "sv << total_relevance << endl;
+    return result;
+}
+
+template <typename ExecutionPolicy>
+BenchmarkResult BenchmarkMatchDocument(string name, const BenchmarkParams& params, const SearchServer& search_server,
+                                       const Corpus& corpus, ExecutionPolicy policy) {
+    size_t word_count = 0;
+    BenchmarkResult result = RunBenchmark(move(name), params, corpus.documents.size(), [&] {
+        for (size_t id = 0; id < corpus.documents.size(); ++id) {
+            const auto [words, status] = search_server.MatchDocument(policy, corpus.match_query, id);
+            word_count += words.size();
+        }
+    });
+    cerr << result.name << " checksum: "sv << word_count << endl;
+    return result;
+}
+
+template <typename ExecutionPolicy>
+BenchmarkResult BenchmarkRemoveDocument(string name, const BenchmarkParams& params, const Corpus& corpus, ExecutionPolicy policy) {
+    SearchServer search_server(corpus.dictionary[0]);
+    FillServer(search_server, corpus);
+    return RunBenchmark(move(name), params, corpus.documents.size(), [&] {
+        for (size_t id = 0; id < corpus.documents.size(); ++id) {
+            search_server.RemoveDocument(policy, id);
+        }
+    });
+}
+
+BenchmarkResult BenchmarkRemoveDocuments(string name, const BenchmarkParams& params, const Corpus& corpus) {
+    SearchServer search_server(corpus.dictionary[0]);
+    FillServer(search_server, corpus);
+    vector<int> document_ids(corpus.documents.size());
+    iota(document_ids.begin(), document_ids.end(), 0);
+    // одна пачка на все документы: пометка надгробиями и одна чистка по словам
+    return RunBenchmark(move(name), params, corpus.documents.size(), [&] {
+        search_server.RemoveDocuments(document_ids);
+    });
+}
+
+BenchmarkResult BenchmarkInterleavedIngest(string name, const BenchmarkParams& params, const Corpus& corpus) {
+    // каждый документ приносит в словарь новое слово, а за каждым добавлением идут однословные запросы с шаблоном
+    // и с опечаткой: словарь меняется между любыми двумя запросами, а сами запросы дешевые, и замер показывает
+    // в основном цену поддержки словаря
+    vector<string> documents;
+    vector<string> pattern_queries;
+    vector<string> typo_queries;
+    documents.reserve(corpus.documents.size());
+    pattern_queries.reserve(corpus.documents.size());
+    typo_queries.reserve(corpus.documents.size());
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        documents.push_back(corpus.documents[i] + " novel"s + to_string(i));
+        const string& query = corpus.queries[i % corpus.queries.size()];
+        pattern_queries.push_back(query.substr(0, min<size_t>(4, query.find(' '))) + "*"s);
+        const string& typo_query = corpus.typo_queries[i % corpus.typo_queries.size()];
+        typo_queries.push_back(typo_query.substr(0, typo_query.find(' ')));
+    }
+
+    SearchServer search_server(corpus.dictionary[0]);
+    search_server.SetFuzzyDistance(2);
+    size_t found = 0;
+    BenchmarkResult result = RunBenchmark(move(name), params, documents.size(), [&] {
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+            found += search_server.FindTopDocuments(pattern_queries[i]).size();
+            found += search_server.FindTopDocuments(typo_queries[i]).size();
+        }
+    });
+    cerr << result.name << " checksum: "sv << found << endl;
+    return result;
+}
+
+void RunSuite(const BenchmarkConfig& config, int document_count, int vocabulary_size, vector<BenchmarkResult>& results) {
+    const Corpus corpus = MakeCorpus(config, document_count, vocabulary_size);
+    const BenchmarkParams params = {
+        {"documents"s, document_count},
+        {"vocabulary"s, static_cast<int>(corpus.dictionary.size())},
+        {"document_words"s, config.words_in_document},
+        {"query_words"s, config.words_in_query},
+    };
+
+    SearchServer search_server(corpus.dictionary[0]);
+    results.push_back(RunBenchmark("AddDocument"s, params, corpus.documents.size(), [&] {
+        FillServer(search_server, corpus);
+    }));
+
+    results.push_back(BenchmarkFindTopDocuments("FindTopDocuments/seq"s, params, search_server, corpus.queries, execution::seq));
+    results.push_back(BenchmarkFindTopDocuments("FindTopDocuments/par"s, params, search_server, corpus.queries, execution::par));
+    results.push_back(BenchmarkPreparedQueries("FindTopDocuments/prepared"s, params, search_server, corpus.queries));
+
+    // запросы с опечатками: без нечеткого поиска почти все слова неизвестны, с ним -- раскрываются автоматом
+    search_server.SetFuzzyDistance(2);
+    results.push_back(BenchmarkFindTopDocuments("FindTopDocuments/fuzzy"s, params, search_server, corpus.typo_queries, execution::seq));
+    search_server.SetFuzzyDistance(0);
+
+    search_server.SetRankingFunction(RankingFunction::BM25);
+    results.push_back(BenchmarkFindTopDocuments("FindTopDocuments/bm25"s, params, search_server, corpus.queries, execution::seq));
+    search_server.SetRankingFunction(RankingFunction::TF_IDF);
+
+    results.push_back(BenchmarkMatchDocument("MatchDocument/seq"s, params, search_server, corpus, execution::seq));
+    results.push_back(BenchmarkMatchDocument("MatchDocument/par"s, params, search_server, corpus, execution::par));
+
+    results.push_back(RunBenchmark("ProcessQueries"s, params, corpus.queries.size(), [&] {
+        const auto documents_lists = ProcessQueries(search_server, corpus.queries);
+    }));
+    {
+        NumaExecutor executor(search_server);
+        results.push_back(RunBenchmark("ProcessQueries/numa"s, params, corpus.queries.size(), [&] {
+            const auto documents_lists = executor.ProcessQueries(corpus.queries);
+        }));
+    }
+
+    results.push_back(BenchmarkInterleavedIngest("AddDocument/interleaved"s, params, corpus));
+
+    results.push_back(BenchmarkRemoveDocument("RemoveDocument/seq"s, params, corpus, execution::seq));
+    results.push_back(BenchmarkRemoveDocument("RemoveDocument/par"s, params, corpus, execution::par));
+    results.push_back(BenchmarkRemoveDocuments("RemoveDocuments/batch"s, params, corpus));
+
+    {
+        SearchServer server_with_duplicates(corpus.dictionary[0]);
+        FillServer(server_with_duplicates, corpus);
+        // RemoveDuplicates печатает найденные дубликаты в cout, а там у нас JSON
+        streambuf* cout_buffer = cout.rdbuf(cerr.rdbuf());
+        results.push_back(RunBenchmark("RemoveDuplicates"s, params, corpus.documents.size(), [&] {
+            RemoveDuplicates(server_with_duplicates);
+        }));
+        cout.rdbuf(cout_buffer);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const BenchmarkConfig config = ParseArguments(argc, argv);
+
+    vector<BenchmarkResult> results;
+    for (const int document_count : config.document_counts) {
+        for (const int vocabulary_size : config.vocabulary_sizes) {
+            RunSuite(config, document_count, vocabulary_size, results);
+        }
+    }
+
+    if (config.output_path.empty()) {
+        PrintBenchmarkResultsJson(cout, results);
+    } else {
+        ofstream output(config.output_path);
+        PrintBenchmarkResultsJson(output, results);
+    }
+
+    return 0;
+}
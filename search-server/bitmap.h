@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// плотное множество неотрицательных чисел (внутренних id документов): по биту на каждое число;
+// слова битов выделяются в переданном memory_resource, копия -- в ресурсе по умолчанию
+class Bitmap {
+public:
+
+    explicit Bitmap(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : words_(resource) {}
+
+    explicit Bitmap(size_t size, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : size_(size), words_((size + WORD_BITS - 1) / WORD_BITS, resource) {}
+
+    size_t Size() const { return size_; }
+
+    // байт в куче
+    size_t MemoryUsage() const { return words_.capacity() * sizeof(uint64_t); }
+
+    void Resize(size_t size) {
+        size_ = size;
+        words_.resize((size + WORD_BITS - 1) / WORD_BITS);
+    }
+
+    // освобождает и память битов; ресурс остается прежним
+    void Clear() {
+        size_ = 0;
+        words_.clear();
+        words_.shrink_to_fit();
+    }
+
+    bool Test(size_t i) const {
+        return i < size_ && (words_[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    void Set(size_t i) {
+        words_[i / WORD_BITS] |= uint64_t{1} << (i % WORD_BITS);
+    }
+
+    void Reset(size_t i) {
+        words_[i / WORD_BITS] &= ~(uint64_t{1} << (i % WORD_BITS));
+    }
+
+    bool Any() const {
+        for (uint64_t word : words_) {
+            if (word != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t Count() const {
+        size_t count = 0;
+        for (uint64_t word : words_) {
+            count += __builtin_popcountll(word);
+        }
+        return count;
+    }
+
+    // пересечение и объединение выполняются по 64 документа за операцию
+    Bitmap& operator&=(const Bitmap& other) {
+        for (size_t i = 0; i < words_.size(); ++i) {
+            words_[i] &= i < other.words_.size() ? other.words_[i] : 0;
+        }
+        return *this;
+    }
+
+    Bitmap& operator|=(const Bitmap& other) {
+        if (other.size_ > size_) {
+            Resize(other.size_);
+        }
+        for (size_t i = 0; i < other.words_.size(); ++i) {
+            words_[i] |= other.words_[i];
+        }
+        return *this;
+    }
+
+private:
+    static const size_t WORD_BITS = 64;
+
+    size_t size_ = 0;
+    std::pmr::vector<uint64_t> words_;
+};
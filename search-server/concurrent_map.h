@@ -40,9 +40,21 @@ public:
     }
 
     void erase(Key key) {
+        // erase зовут из параллельного for_each, так что корзину тоже надо блокировать
+        std::lock_guard<std::mutex> guard(cm_[key % buckets_].guard);
         cm_[key % buckets_].Map.erase(key);
     }
 
+    size_t Size() {
+        size_t result = 0;
+        for (auto& cmap : cm_) {
+            std::lock_guard<std::mutex> guard(cmap.guard);
+            result += cmap.Map.size();
+        }
+
+        return result;
+    }
+
 private:
 
     struct CMap {
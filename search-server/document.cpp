@@ -18,4 +18,8 @@ std::ostream& operator<<(std::ostream& output, const Document& doc) {
     << ", rating = "sv << doc.rating << " }"sv;
 
     return output;
-}
\ No newline at end of file
+}
+
+SearchCursor MakeSearchCursor(const Document& last_document) {
+    return {last_document.relevance, last_document.rating, last_document.id};
+}
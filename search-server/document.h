@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <optional>
+#include <vector>
 
 enum class DocumentStatus {
     ACTUAL,
@@ -8,6 +10,9 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// количество значений DocumentStatus -- для массивов, индексированных статусом
+const int DOCUMENT_STATUS_COUNT = 4;
+
 struct Document {
 
     Document();
@@ -19,4 +24,23 @@ struct Document {
     int rating = 0;
 };
 
-std::ostream& operator<<(std::ostream& output, const Document& doc);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& output, const Document& doc);
+
+// позиция в выдаче для постраничного поиска: следующая страница начнется сразу после этого документа
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = 0;
+};
+
+SearchCursor MakeSearchCursor(const Document& last_document);
+
+struct SearchPage {
+    std::vector<Document> documents;
+    std::optional<SearchCursor> next_cursor; // nullopt -- страниц больше нет
+};
+
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_truncated = false; // поиск прерван сроком или отменой -- лучшее из того, что успели посчитать
+};
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "document_filter.h"
+
+DocumentFilter<> StatusIn(std::initializer_list<DocumentStatus> statuses) {
+    DocumentFilter<> filter;
+    filter.status_mask = 0;
+    for (DocumentStatus status : statuses) {
+        filter.status_mask |= 1u << static_cast<int>(status);
+    }
+
+    return filter;
+}
+
+DocumentFilter<> RatingBetween(int min_rating, int max_rating) {
+    DocumentFilter<> filter;
+    filter.min_rating = min_rating;
+    filter.max_rating = max_rating;
+
+    return filter;
+}
+
+DocumentFilter<> IdBetween(int min_id, int max_id) {
+    DocumentFilter<> filter;
+    filter.min_id = min_id;
+    filter.max_id = max_id;
+
+    return filter;
+}
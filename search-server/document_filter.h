@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <initializer_list>
+#include <type_traits>
+#include "document.h"
+
+// предикат "подходит любой документ": движок узнает его на этапе компиляции и не вызывает
+struct AnyDocument {
+    bool operator()(int document_id, DocumentStatus status, int rating) const {
+        return true;
+    }
+};
+
+const unsigned ALL_STATUSES_MASK = (1u << DOCUMENT_STATUS_COUNT) - 1;
+
+// выражение фильтра для FindTopDocuments: множество статусов, диапазоны рейтинга и id
+// и произвольный предикат как запасной вариант; всё, кроме предиката, движок проверяет по колонкам атрибутов
+template <typename Predicate = AnyDocument>
+struct DocumentFilter {
+    using PredicateType = Predicate;
+
+    unsigned status_mask = ALL_STATUSES_MASK;
+    int min_rating = INT_MIN;
+    int max_rating = INT_MAX;
+    int min_id = 0;
+    int max_id = INT_MAX;
+    Predicate predicate;
+
+    bool HasStatus(DocumentStatus status) const {
+        return status_mask & (1u << static_cast<int>(status));
+    }
+
+    bool IsRatingRestricted() const {
+        return min_rating != INT_MIN || max_rating != INT_MAX;
+    }
+
+    bool IsIdRestricted() const {
+        return min_id != 0 || max_id != INT_MAX;
+    }
+
+    // ни один документ не пройдет такой фильтр
+    bool IsEmpty() const {
+        return status_mask == 0 || min_rating > max_rating || min_id > max_id;
+    }
+};
+
+template <typename T>
+struct IsDocumentFilter : std::false_type {};
+
+template <typename Predicate>
+struct IsDocumentFilter<DocumentFilter<Predicate>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_document_filter_v = IsDocumentFilter<T>::value;
+
+DocumentFilter<> StatusIn(std::initializer_list<DocumentStatus> statuses);
+
+DocumentFilter<> RatingBetween(int min_rating, int max_rating);
+
+DocumentFilter<> IdBetween(int min_id, int max_id);
+
+template <typename Predicate>
+DocumentFilter<Predicate> Where(Predicate predicate) {
+    return {ALL_STATUSES_MASK, INT_MIN, INT_MAX, 0, INT_MAX, predicate};
+}
+
+// пересечение двух фильтров; если оба предиката -- AnyDocument, предикат так и останется невызываемым
+template <typename LhsPredicate, typename RhsPredicate>
+auto operator&&(const DocumentFilter<LhsPredicate>& lhs, const DocumentFilter<RhsPredicate>& rhs) {
+    auto combine = [&lhs, &rhs](auto predicate) {
+        return DocumentFilter<decltype(predicate)>{
+            lhs.status_mask & rhs.status_mask,
+            std::max(lhs.min_rating, rhs.min_rating), std::min(lhs.max_rating, rhs.max_rating),
+            std::max(lhs.min_id, rhs.min_id), std::min(lhs.max_id, rhs.max_id),
+            predicate};
+    };
+
+    if constexpr (std::is_same_v<RhsPredicate, AnyDocument>) {
+        return combine(lhs.predicate);
+    } else if constexpr (std::is_same_v<LhsPredicate, AnyDocument>) {
+        return combine(rhs.predicate);
+    } else {
+        return combine([lhs_predicate = lhs.predicate, rhs_predicate = rhs.predicate](int document_id, DocumentStatus status, int rating) {
+            return lhs_predicate(document_id, status, rating) && rhs_predicate(document_id, status, rating);
+        });
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "memory_usage.h"
+
+// Таблица внешний id документа -- внутренний id с открытой адресацией: пара из двух int на слот, слоты лежат
+// одним массивом, коллизии разрешаются линейным пробированием, удаление сдвигает хвост цепочки назад.
+// Внешние id неотрицательны, поэтому -1 в слоте означает, что он свободен.
+// Внешние id часто идут подряд, и хеш перемешивает их умножением, чтобы соседние id не занимали соседние слоты.
+class DocumentIdMap {
+public:
+    using Allocator = CountingAllocator<char>;
+
+    static constexpr int NOT_FOUND = -1;
+
+    explicit DocumentIdMap(const Allocator& allocator = Allocator())
+        : slots_(SlotAllocator(allocator)) {
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // внутренний id или NOT_FOUND
+    int Find(int external_id) const {
+        if (slots_.empty()) {
+            return NOT_FOUND;
+        }
+
+        const size_t mask = slots_.size() - 1;
+        for (size_t index = Hash(external_id) & mask; slots_[index].external_id != FREE; index = (index + 1) & mask) {
+            if (slots_[index].external_id == external_id) {
+                return slots_[index].internal_id;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    // external_id должно еще не быть в таблице
+    void Insert(int external_id, int internal_id) {
+        // загрузка не больше 3/4, как у TermHashMap
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            Rehash(std::max<size_t>(MIN_CAPACITY, slots_.size() * 2));
+        }
+
+        const size_t mask = slots_.size() - 1;
+        size_t index = Hash(external_id) & mask;
+        while (slots_[index].external_id != FREE) {
+            index = (index + 1) & mask;
+        }
+        slots_[index] = {external_id, internal_id};
+        ++size_;
+    }
+
+    // сколько id удалено: 0 или 1
+    size_t Erase(int external_id) {
+        if (slots_.empty()) {
+            return 0;
+        }
+
+        const size_t mask = slots_.size() - 1;
+        size_t hole = Hash(external_id) & mask;
+        while (slots_[hole].external_id != external_id) {
+            if (slots_[hole].external_id == FREE) {
+                return 0;
+            }
+            hole = (hole + 1) & mask;
+        }
+
+        // слот из цепочки за дырой переезжает в нее, если дыра не раньше его домашнего слота по ходу пробирования
+        for (size_t next = (hole + 1) & mask; slots_[next].external_id != FREE; next = (next + 1) & mask) {
+            const size_t home = Hash(slots_[next].external_id) & mask;
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots_[hole] = slots_[next];
+                hole = next;
+            }
+        }
+
+        slots_[hole].external_id = FREE;
+        --size_;
+        return 1;
+    }
+
+    // освобождает и массив слотов
+    void Clear() {
+        SlotVector(slots_.get_allocator()).swap(slots_);
+        size_ = 0;
+    }
+
+private:
+
+    static constexpr int FREE = -1;
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    struct Slot {
+        int external_id = FREE;
+        int internal_id = 0;
+    };
+
+    using SlotAllocator = CountingAllocator<Slot>;
+    using SlotVector = std::vector<Slot, SlotAllocator>;
+
+    static uint64_t Hash(int external_id) {
+        // мультипликативный хеш Фибоначчи; старшие биты произведения перемешаны лучше младших
+        const uint64_t product = static_cast<uint64_t>(external_id) * 0x9e3779b97f4a7c15ull;
+        return product ^ (product >> 32);
+    }
+
+    void Rehash(size_t capacity) {
+        SlotVector slots(capacity, Slot{}, slots_.get_allocator());
+        const size_t mask = capacity - 1;
+        for (const Slot& slot : slots_) {
+            if (slot.external_id == FREE) {
+                continue;
+            }
+            size_t index = Hash(slot.external_id) & mask;
+            while (slots[index].external_id != FREE) {
+                index = (index + 1) & mask;
+            }
+            slots[index] = slot;
+        }
+        slots_.swap(slots);
+    }
+
+    SlotVector slots_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,78 @@
+#include <algorithm>
+
+#include "levenshtein_automaton.h"
+
+// клетка t полосы после depth символов -- клетка таблицы динамики i = depth - max_distance + t,
+// то есть расстояние между прочитанным префиксом и первыми i символами слова
+
+LevenshteinAutomaton::LevenshteinAutomaton(std::string_view word, int max_distance)
+    : word_(word)
+    , max_distance_(max_distance)
+    , width_(2 * max_distance + 1) {
+}
+
+std::string_view LevenshteinAutomaton::GetWord() const {
+    return word_;
+}
+
+int LevenshteinAutomaton::GetMaxDistance() const {
+    return max_distance_;
+}
+
+int LevenshteinAutomaton::GetStateSize() const {
+    return width_;
+}
+
+void LevenshteinAutomaton::Start(int* state) const {
+    // значения больше max_distance + 1 не отличаются от него для ответа, поэтому обрезаем их
+    const int limit = max_distance_ + 1;
+    for (int t = 0; t < width_; ++t) {
+        const int i = t - max_distance_;
+        state[t] = i < 0 || i > static_cast<int>(word_.size()) ? limit : std::min(i, limit);
+    }
+}
+
+void LevenshteinAutomaton::Step(const int* state, size_t depth, char c, int* next) const {
+    const int limit = max_distance_ + 1;
+    const int word_size = word_.size();
+    const int first = static_cast<int>(depth) + 1 - max_distance_; // i для клетки 0 новой полосы
+
+    int left = limit; // клетка слева в новой полосе
+    for (int t = 0; t < width_; ++t) {
+        const int i = first + t;
+        int value = limit;
+        if (i == 0) {
+            value = std::min(static_cast<int>(depth) + 1, limit);
+        } else if (i > 0 && i <= word_size) {
+            // замена (или совпадение) -- клетка t старой полосы, вставка -- клетка t + 1 старой, удаление -- слева в новой
+            const int replace = state[t] + (word_[i - 1] != c);
+            const int insert = t + 1 < width_ ? state[t + 1] + 1 : limit;
+            value = std::min({replace, insert, left + 1, limit});
+        }
+        next[t] = value;
+        left = value;
+    }
+}
+
+bool LevenshteinAutomaton::IsMatch(const int* state, size_t depth) const {
+    return GetDistance(state, depth) <= max_distance_;
+}
+
+bool LevenshteinAutomaton::CanMatch(const int* state) const {
+    return *std::min_element(state, state + width_) <= max_distance_;
+}
+
+int LevenshteinAutomaton::GetDistance(const int* state, size_t depth) const {
+    const int t = static_cast<int>(word_.size()) - static_cast<int>(depth) + max_distance_;
+    return t < 0 || t >= width_ ? max_distance_ + 1 : state[t];
+}
+
+int GetFuzzyDistanceForWord(std::string_view word, int max_distance) {
+    if (word.size() < 3) {
+        return 0;
+    }
+    if (word.size() < 6) {
+        return std::min(max_distance, 1);
+    }
+    return max_distance;
+}
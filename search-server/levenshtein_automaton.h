@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Автомат Левенштейна для слова: принимает слова на расстоянии не больше max_distance.
+// Состояние после depth прочитанных символов -- полоса строки таблицы динамики шириной 2 * max_distance + 1
+// вокруг диагонали (клетки дальше от диагонали заведомо больше max_distance). По мертвому состоянию
+// (CanMatch() == false) сразу видно, что ни одно продолжение префикса не подойдет, и проверку слова можно
+// оборвать. Память под состояния выделяет вызывающий.
+class LevenshteinAutomaton {
+public:
+
+    LevenshteinAutomaton(std::string_view word, int max_distance);
+
+    std::string_view GetWord() const;
+
+    int GetMaxDistance() const;
+
+    int GetStateSize() const;
+
+    void Start(int* state) const;
+
+    // state -- состояние после depth символов, next -- после depth + 1
+    void Step(const int* state, size_t depth, char c, int* next) const;
+
+    // прочитанные depth символов -- целое слово на допустимом расстоянии
+    bool IsMatch(const int* state, size_t depth) const;
+
+    // хоть какое-то продолжение прочитанного префикса может оказаться на допустимом расстоянии
+    bool CanMatch(const int* state) const;
+
+    // расстояние до прочитанного слова; для слов дальше max_distance -- max_distance + 1
+    int GetDistance(const int* state, size_t depth) const;
+
+private:
+    std::string_view word_;
+    int max_distance_;
+    int width_;
+};
+
+// допустимое расстояние для слова: короткие слова с опечаткой почти не отличить от других коротких слов
+int GetFuzzyDistanceForWord(std::string_view word, int max_distance);
@@ -1,6 +1,5 @@
 #include <execution>
 #include <iostream>
-#include <random>
 #include <string>
 #include <vector>
 #include <thread>
@@ -15,122 +14,6 @@
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution('a', 'z')(generator));
-    }
-    return word;
-}
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    sort(words.begin(), words.end());
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
-        }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
-string GenerateQueryForMatchBenchmark(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
-        }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-    }
-    return queries;
-}
-template <typename ExecutionPolicy>
-void TestFindTopDocuments(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    double total_relevance = 0;
-    for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
-            total_relevance += document.relevance;
-        }
-    }
-    cout << total_relevance << endl;
-}
-#define TEST_FIND_TOP_DOCUMENTS(policy) TestFindTopDocuments(#policy, search_server, queries, execution::policy)
-
-
-template <typename QueriesProcessor>
-void Test(string_view mark, QueriesProcessor processor, const SearchServer& search_server, const vector<string>& queries) {
-    LOG_DURATION(mark);
-    const auto documents_lists = processor(search_server, queries);
-}
-#define TEST(processor) Test(#processor, processor, search_server, queries)
-
-template <typename ExecutionPolicy>
-void Test(string_view mark, SearchServer search_server, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    const int document_count = search_server.GetDocumentCount();
-    for (int id = 0; id < document_count; ++id) {
-        search_server.RemoveDocument(policy, id);
-    }
-    cout << search_server.GetDocumentCount() << endl;
-}
-#define TEST_REMOVE(mode) Test(#mode, search_server, execution::mode)
-
-
-template <typename ExecutionPolicy>
-void Test(string_view mark, SearchServer search_server, const string& query, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    const int document_count = search_server.GetDocumentCount();
-    int word_count = 0;
-    for (int id = 0; id < document_count; ++id) {
-        const auto [words, status] = search_server.MatchDocument(policy, query, id);
-        word_count += words.size();
-    }
-    cout << word_count << endl;
-}
-#define TEST_MATCH(policy) Test(#policy, search_server, query, execution::policy)
-
-
-struct RandomData {
-    vector<string> dictionary;
-    vector<string> documents;
-    vector<string> queries;
-};
-
-RandomData MakeRandomData() {
-
-    mt19937 generator;
-    const auto dictionary_ = GenerateDictionary(generator, 2'000, 25);
-    const auto documents_ = GenerateQueries(generator, dictionary_, 20'000, 10);
-    const auto queries_ = GenerateQueries(generator, dictionary_, 2'000, 7);
-
-    return {dictionary_, documents_, queries_};
-}
-
 int main() {
 TestSearchServer();
     std::cerr << "\nSearch server testing finished\n"sv << std::endl;
@@ -260,24 +143,6 @@ TestSearchServer();
         }
     }
 
-    {
-        cout << "BIG TEST_1"sv << endl;
-        
-        RandomData random_data = MakeRandomData();
-
-        //mt19937 generator;
-        //const auto dictionary = GenerateDictionary(generator, 2'000, 25);
-        //const auto documents = GenerateQueries(generator, dictionary, 20'000, 10);
-        SearchServer search_server(random_data.dictionary[0]);
-        for (size_t i = 0; i < random_data.documents.size(); ++i) {
-            search_server.AddDocument(i, random_data.documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-        }
-        
-        // const auto queries = GenerateQueries(generator, dictionary, 2'000, 7);
-        const auto queries = random_data.queries;
-        TEST(ProcessQueries);
-    }
-
     {
         SearchServer search_server("and with"sv);
         int id = 0;
@@ -304,24 +169,6 @@ TestSearchServer();
         }
     }
 
-    {
-        cout << "BIG TEST_2"sv << endl;
-
-        RandomData random_data = MakeRandomData();
-
-        //mt19937 generator;
-        //const auto dictionary = GenerateDictionary(generator, 2'000, 25);
-        //const auto documents = GenerateQueries(generator, dictionary, 20'000, 10);
-        SearchServer search_server(random_data.dictionary[0]);
-        for (size_t i = 0; i < random_data.documents.size(); ++i) {
-            search_server.AddDocument(i, random_data.documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-        }
-        
-        // const auto queries = GenerateQueries(generator, dictionary, 2'000, 7);
-        const auto queries = random_data.queries;
-        TEST(ProcessQueriesJoined);
-    }
-
     {
         SearchServer search_server("and with"sv);
 
@@ -357,33 +204,6 @@ TestSearchServer();
         report();
     }
 
-    {
-        cout << "BIG TEST_3"sv << endl;
-        
-        mt19937 generator;
-
-        const auto dictionary = GenerateDictionary(generator, 10'000, 25);
-        const auto documents = GenerateQueries(generator, dictionary, 10'000, 100);
-
-        {
-            SearchServer search_server(dictionary[0]);
-            for (size_t i = 0; i < documents.size(); ++i) {
-                search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-            }
-
-            TEST_REMOVE(seq);
-        }
-
-        {
-            SearchServer search_server(dictionary[0]);
-            for (size_t i = 0; i < documents.size(); ++i) {
-                search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-            }
-
-            TEST_REMOVE(par);
-        }
-    }
-
     {
         SearchServer search_server("and with"sv);
 
@@ -438,42 +258,6 @@ TestSearchServer();
 
     }
 
-    {
-        cout << "BIG TEST_4"sv << endl;
-
-        mt19937 generator;
-
-        const auto dictionary = GenerateDictionary(generator, 1000, 10);
-        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-
-        const string query = GenerateQueryForMatchBenchmark(generator, dictionary, 500, 0.1);
-
-        SearchServer search_server(dictionary[0]);
-        for (size_t i = 0; i < documents.size(); ++i) {
-            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-        }
-
-        TEST_MATCH(seq);
-        TEST_MATCH(par);
-    }
-
-    {
-        cout << "BIG TEST_5"sv << endl;
-
-        mt19937 generator;
-        const auto dictionary = GenerateDictionary(generator, 1000, 10);
-        const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-        SearchServer search_server(dictionary[0]);
-        for (size_t i = 0; i < documents.size(); ++i) {
-            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-        }
-        const auto queries = GenerateQueries(generator, dictionary, 100, 70);
-        TEST_FIND_TOP_DOCUMENTS(seq);
-        TEST_FIND_TOP_DOCUMENTS(par);
-
-        cout << endl;
-    }
-
     cout << "Search Server Development Complete"s << endl;
 
     return 0;
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <scoped_allocator>
+#include <string>
+
+// сколько байт сейчас выделено в куче через привязанные к счетчику CountingAllocator
+class MemoryCounter {
+public:
+
+    void Add(size_t bytes) {
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void Subtract(size_t bytes) {
+        bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    size_t Get() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> bytes_{0};
+};
+
+// аллокатор поверх std::pmr::memory_resource (по умолчанию -- get_default_resource()), который учитывает
+// выделенные байты в счетчике; без счетчика ничего не учитывает.
+// Счетчик держится через shared_ptr: контейнер, из которого перенесли данные, может пережить новый
+// и освобождать в свой счетчик (перенесенный deque выделяет себе пустую карту блоков).
+// Признаки propagate_on_container_* не объявлены (false): при присваивании и переносе контейнер сохраняет
+// свой аллокатор, и чужие элементы переходят в его счетчик копированием
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+
+    CountingAllocator() noexcept = default;
+
+    explicit CountingAllocator(std::shared_ptr<MemoryCounter> counter,
+                               std::pmr::memory_resource* resource = std::pmr::get_default_resource()) noexcept
+        : counter_(std::move(counter))
+        , resource_(resource) {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter())
+        , resource_(other.GetResource()) {
+    }
+
+    T* allocate(size_t n) {
+        T* result = static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+        if (counter_) {
+            counter_->Add(n * sizeof(T));
+        }
+        return result;
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (counter_) {
+            counter_->Subtract(n * sizeof(T));
+        }
+        resource_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    const std::shared_ptr<MemoryCounter>& GetCounter() const noexcept {
+        return counter_;
+    }
+
+    std::pmr::memory_resource* GetResource() const noexcept {
+        return resource_;
+    }
+
+private:
+    std::shared_ptr<MemoryCounter> counter_;
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter() && *lhs.GetResource() == *rhs.GetResource();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+// вложенные контейнеры (map внутри map, строки в deque) получают аллокатор внешнего и считаются в тот же счетчик
+template <typename T>
+using ScopedCountingAllocator = std::scoped_allocator_adaptor<CountingAllocator<T>>;
+
+using CountedString = std::basic_string<char, std::char_traits<char>, CountingAllocator<char>>;
+
+// память индекса по структурам, в байтах, выделенных в куче (без служебных заголовков malloc);
+// узловые структуры считаются аллокаторами, колонки -- по емкости векторов
+struct MemoryUsage {
+    size_t documents_text = 0;   // тексты документов, на которые смотрят вью индекса
+    size_t term_index = 0;       // слово -- постинги
+    size_t document_index = 0;   // документ -- частоты слов
+    size_t document_ids = 0;     // множество внешних id и таблица внешний id -- внутренний
+    size_t columns = 0;          // колонки атрибутов и битмапы статусов
+    size_t positional_index = 0; // позиции слов для фразовых запросов
+    size_t caches = 0;           // снимки словаря для нечеткого поиска и норм длин для BM25
+    size_t total = 0;
+};
+
+// что делать, когда добавление документа выводит индекс за бюджет памяти
+enum class MemoryBudgetPolicy {
+    REJECT,  // бросить invalid_argument, индекс не меняется
+    COMPACT, // сначала уплотнить индекс (Compact) и бросить, только если это не помогло
+};
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+#include "near_duplicates.h"
+
+namespace {
+
+const int SIGNATURE_SIZE = NEAR_DUPLICATES_BANDS * NEAR_DUPLICATES_ROWS_IN_BAND;
+
+// splitmix64 -- дешевое перемешивание, из одного хеша слова получаем SIGNATURE_SIZE "независимых" хешей
+uint64_t Mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+std::vector<uint64_t> ComputeSignature(const WordFrequencies& word_frequencies) {
+    std::vector<uint64_t> signature(SIGNATURE_SIZE, std::numeric_limits<uint64_t>::max());
+    for (const auto& [word, _] : word_frequencies) {
+        const uint64_t word_hash = std::hash<std::string_view>{}(word);
+        for (int i = 0; i < SIGNATURE_SIZE; ++i) {
+            signature[i] = std::min(signature[i], Mix(word_hash ^ Mix(i)));
+        }
+    }
+
+    return signature;
+}
+
+// точная мера Жаккара непустых множеств; слова в GetWordFrequencies уже отсортированы, поэтому пересечение считаем слиянием
+double ComputeJaccard(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    size_t intersection = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (lhs_it->first < rhs_it->first) {
+            ++lhs_it;
+        } else if (rhs_it->first < lhs_it->first) {
+            ++rhs_it;
+        } else {
+            ++intersection;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+
+    return static_cast<double>(intersection) / (lhs.size() + rhs.size() - intersection);
+}
+
+// у пустых множеств мера Жаккара не определена: документы из одних стоп-слов ничем друг на друга не похожи
+bool IsNearDuplicate(const WordFrequencies& lhs, const WordFrequencies& rhs, double jaccard_threshold) {
+    return !lhs.empty() && !rhs.empty() && ComputeJaccard(lhs, rhs) >= jaccard_threshold;
+}
+
+} // namespace
+
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, double jaccard_threshold) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    const size_t document_count = document_ids.size();
+
+    std::vector<std::vector<uint64_t>> signatures(document_count);
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), signatures.begin(),
+                   [&search_server](int document_id) { return ComputeSignature(search_server.GetWordFrequencies(document_id)); });
+
+    // каждая полоса сигнатуры раскладывает документы по своим корзинам независимо от других полос;
+    // чтобы не порождать квадрат пар внутри большой корзины, в кандидаты идет каждый документ с первым в корзине
+    std::vector<int> bands(NEAR_DUPLICATES_BANDS);
+    std::iota(bands.begin(), bands.end(), 0);
+
+    std::vector<std::vector<std::pair<int, int>>> candidates_by_band(NEAR_DUPLICATES_BANDS);
+    std::transform(std::execution::par, bands.begin(), bands.end(), candidates_by_band.begin(),
+                   [&signatures, document_count](int band) {
+                       std::unordered_map<uint64_t, int> first_in_bucket;
+                       first_in_bucket.reserve(document_count);
+                       std::vector<std::pair<int, int>> candidates;
+                       for (size_t i = 0; i < document_count; ++i) {
+                           uint64_t band_hash = Mix(band);
+                           for (int row = 0; row < NEAR_DUPLICATES_ROWS_IN_BAND; ++row) {
+                               band_hash = Mix(band_hash ^ signatures[i][band * NEAR_DUPLICATES_ROWS_IN_BAND + row]);
+                           }
+
+                           const auto [it, inserted] = first_in_bucket.emplace(band_hash, static_cast<int>(i));
+                           if (!inserted) {
+                               candidates.emplace_back(it->second, static_cast<int>(i));
+                           }
+                       }
+                       return candidates;
+                   });
+
+    std::vector<std::pair<int, int>> candidates;
+    for (const auto& band_candidates : candidates_by_band) {
+        candidates.insert(candidates.end(), band_candidates.begin(), band_candidates.end());
+    }
+    // пары [первый в корзине -- документ] по документу: первый в корзине всегда раньше документа
+    std::sort(std::execution::par, candidates.begin(), candidates.end(),
+              [](const std::pair<int, int>& lhs, const std::pair<int, int>& rhs) {
+                  return std::tie(lhs.second, lhs.first) < std::tie(rhs.second, rhs.first);
+              });
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // документы по возрастанию id: каждый присоединяется к группе первого похожего кандидата, если похож
+    // на ее представителя -- документ с наименьшим id, который останется после RemoveNearDuplicates; иначе
+    // становится представителем сам. LSH дает лишь кандидатов, поэтому сходство проверяем точной мерой
+    std::vector<int> representatives(document_count);
+    std::iota(representatives.begin(), representatives.end(), 0);
+    for (size_t begin = 0, end = 0; begin < candidates.size(); begin = end) {
+        const int document = candidates[begin].second;
+        const WordFrequencies& words = search_server.GetWordFrequencies(document_ids[document]);
+        for (end = begin; end < candidates.size() && candidates[end].second == document; ++end) {
+            const int representative = representatives[candidates[end].first];
+            if (representatives[document] == document
+                && IsNearDuplicate(search_server.GetWordFrequencies(document_ids[representative]), words, jaccard_threshold)) {
+                representatives[document] = representative;
+            }
+        }
+    }
+
+    std::map<int, std::vector<int>> clusters;
+    for (size_t i = 0; i < document_count; ++i) {
+        clusters[representatives[i]].push_back(document_ids[i]);
+    }
+
+    std::vector<std::vector<int>> result;
+    for (auto& [_, cluster] : clusters) {
+        if (cluster.size() > 1) {
+            result.push_back(std::move(cluster));
+        }
+    }
+    // id в document_ids идут по возрастанию, значит и внутри групп тоже; упорядочим группы по первому id
+    std::sort(result.begin(), result.end());
+
+    return result;
+}
+
+void RemoveNearDuplicates(SearchServer& search_server, double jaccard_threshold) {
+    std::vector<int> removed_documents;
+    for (const auto& cluster : FindNearDuplicates(search_server, jaccard_threshold)) {
+        removed_documents.insert(removed_documents.end(), std::next(cluster.begin()), cluster.end());
+    }
+    std::sort(removed_documents.begin(), removed_documents.end());
+
+    for (const int document_id : removed_documents) {
+        std::cout << "Found near duplicate document id "sv << document_id << std::endl;
+        search_server.RemoveDocument(document_id);
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include "search_server.h"
+
+// параметры MinHash/LSH: сигнатура из NEAR_DUPLICATES_BANDS * NEAR_DUPLICATES_ROWS_IN_BAND хешей;
+// документы попадают в кандидаты, если совпала хотя бы одна полоса (band) сигнатуры целиком
+const int NEAR_DUPLICATES_BANDS = 16;
+const int NEAR_DUPLICATES_ROWS_IN_BAND = 4;
+const double DEFAULT_JACCARD_THRESHOLD = 0.8;
+
+// ищет группы почти-дубликатов: каждый документ группы похож по Жаккару не меньше, чем на jaccard_threshold,
+// на ее первый документ (с наименьшим id) -- сходство не наследуется по цепочке, и похожие на второй документ
+// группы, но не на первый, в нее не попадают. Документы без слов (из одних стоп-слов) дубликатами не считаются.
+// Каждая группа отсортирована по возрастанию id, группы -- по первому id
+std::vector<std::vector<int>> FindNearDuplicates(const SearchServer& search_server, double jaccard_threshold = DEFAULT_JACCARD_THRESHOLD);
+
+// удаляет из каждой группы почти-дубликатов все документы, кроме документа с наименьшим id
+void RemoveNearDuplicates(SearchServer& search_server, double jaccard_threshold = DEFAULT_JACCARD_THRESHOLD);
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "numa_executor.h"
+
+namespace {
+
+// список процессоров в формате ядра: "0-3,8,10-11"
+std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    std::istringstream input(text);
+    for (std::string range; std::getline(input, range, ',');) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> GetFallbackTopology() {
+    NumaNode node;
+    const int cpu_count = std::max(1u, std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < cpu_count; ++cpu) {
+        node.cpus.push_back(cpu);
+    }
+    return {node};
+}
+
+} // namespace
+
+std::vector<NumaNode> GetNumaTopology() {
+#ifdef __linux__
+    const std::string node_root = "/sys/devices/system/node/";
+    std::ifstream online(node_root + "online");
+    std::string online_nodes;
+    if (!std::getline(online, online_nodes)) {
+        return GetFallbackTopology();
+    }
+
+    std::vector<NumaNode> nodes;
+    for (const int node_id : ParseCpuList(online_nodes)) {
+        std::ifstream cpulist(node_root + "node" + std::to_string(node_id) + "/cpulist");
+        std::string cpus;
+        std::getline(cpulist, cpus);
+
+        NumaNode node;
+        node.id = node_id;
+        node.cpus = ParseCpuList(cpus);
+        // узел только с памятью (без процессоров) исполнять запросы не может
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+
+    return nodes.empty() ? GetFallbackTopology() : nodes;
+#else
+    return GetFallbackTopology();
+#endif
+}
+
+bool PinCurrentThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+    return CPU_COUNT(&cpu_set) > 0 && pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    return false;
+#endif
+}
+
+NumaExecutor::NumaExecutor(const SearchServer& search_server, size_t workers_per_node /* = 0 */)
+    : NumaExecutor(search_server, workers_per_node, false) {
+}
+
+NumaExecutor::NumaExecutor(const SearchServer& search_server, size_t workers_per_node, bool force_replicas) {
+    const std::vector<NumaNode> topology = GetNumaTopology();
+    const bool need_replicas = force_replicas || topology.size() > 1;
+
+    for (const NumaNode& numa_node : topology) {
+        auto node = std::make_unique<Node>();
+        node->topology = numa_node;
+        node->search_server = &search_server;
+        nodes_.push_back(std::move(node));
+    }
+
+    if (need_replicas) {
+        // каждую копию строит поток, привязанный к своему узлу: память индекса выделяется и впервые трогается там
+        std::vector<std::thread> builders;
+        for (const auto& node : nodes_) {
+            builders.emplace_back([&search_server, node = node.get()]() {
+                PinCurrentThread(node->topology.cpus);
+                node->replica = std::make_unique<SearchServer>(search_server);
+                node->search_server = node->replica.get();
+            });
+        }
+        for (std::thread& builder : builders) {
+            builder.join();
+        }
+    }
+
+    for (const auto& node : nodes_) {
+        const size_t worker_count = workers_per_node > 0 ? workers_per_node : node->topology.cpus.size();
+        for (size_t i = 0; i < worker_count; ++i) {
+            node->workers.emplace_back([this, node = node.get()]() { RunWorker(*node); });
+        }
+    }
+}
+
+NumaExecutor::~NumaExecutor() {
+    for (const auto& node : nodes_) {
+        {
+            std::lock_guard guard(node->guard);
+            node->is_stopping = true;
+        }
+        node->has_tasks.notify_all();
+    }
+    for (const auto& node : nodes_) {
+        for (std::thread& worker : node->workers) {
+            worker.join();
+        }
+    }
+}
+
+size_t NumaExecutor::GetNodeCount() const {
+    return nodes_.size();
+}
+
+bool NumaExecutor::HasReplicas() const {
+    return nodes_.front()->replica != nullptr;
+}
+
+std::future<std::vector<Document>> NumaExecutor::Submit(std::string raw_query) {
+    auto task = std::make_shared<std::packaged_task<std::vector<Document>(const SearchServer&)>>(
+        [query = std::move(raw_query)](const SearchServer& search_server) { return search_server.FindTopDocuments(query); });
+    std::future<std::vector<Document>> result = task->get_future();
+
+    // данные есть на каждом узле, так что выбираем по длине очереди
+    Node& node = **std::min_element(nodes_.begin(), nodes_.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs->queued.load(std::memory_order_relaxed) < rhs->queued.load(std::memory_order_relaxed);
+    });
+    Push(node, [task](const SearchServer& search_server) { (*task)(search_server); });
+
+    return result;
+}
+
+std::vector<std::vector<Document>> NumaExecutor::ProcessQueries(const std::vector<std::string>& queries) {
+    std::vector<std::future<std::vector<Document>>> futures;
+    futures.reserve(queries.size());
+    for (const std::string& query : queries) {
+        futures.push_back(Submit(query));
+    }
+
+    std::vector<std::vector<Document>> result;
+    result.reserve(queries.size());
+    for (auto& future : futures) {
+        result.push_back(future.get());
+    }
+    return result;
+}
+
+void NumaExecutor::Push(Node& node, Task task) {
+    {
+        std::lock_guard guard(node.guard);
+        node.tasks.push_back(std::move(task));
+        node.queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    node.has_tasks.notify_one();
+}
+
+void NumaExecutor::RunWorker(Node& node) {
+    PinCurrentThread(node.topology.cpus);
+
+    while (true) {
+        Task task;
+        {
+            std::unique_lock lock(node.guard);
+            node.has_tasks.wait(lock, [&node]() { return node.is_stopping || !node.tasks.empty(); });
+            if (node.tasks.empty()) {
+                return;
+            }
+            task = std::move(node.tasks.front());
+            node.tasks.pop_front();
+        }
+
+        task(*node.search_server);
+        node.queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+// узлы NUMA по /sys/devices/system/node; если NUMA нет или это не Linux -- один узел со всеми процессорами
+std::vector<NumaNode> GetNumaTopology();
+
+// привязывает текущий поток к процессорам cpus; false -- платформа не умеет или ядро отказало, поток работает где угодно
+bool PinCurrentThread(const std::vector<int>& cpus);
+
+// Исполнитель запросов с пулом потоков на каждом узле NUMA: потоки узла привязаны к его процессорам.
+// Если узлов больше одного, каждый узел получает свою копию индекса, которую строит поток этого узла, --
+// при обычной политике ядра "first touch" ее страницы лежат в памяти этого же узла, и запросы не ходят через
+// межпроцессорную шину. Запрос отправляется на узел с самой короткой очередью и выполняется его потоками
+// по локальной копии. Копии -- снимок индекса на момент создания исполнителя; на одном узле копия не делается
+// и используется сам search_server, который должен пережить исполнитель и не меняться.
+class NumaExecutor {
+public:
+
+    // workers_per_node == 0 -- по потоку на каждый процессор узла
+    explicit NumaExecutor(const SearchServer& search_server, size_t workers_per_node = 0);
+
+    // копии индекса строятся на всех узлах, даже если узел один (для проверки и замеров)
+    NumaExecutor(const SearchServer& search_server, size_t workers_per_node, bool force_replicas);
+
+    NumaExecutor(const NumaExecutor&) = delete;
+    NumaExecutor& operator=(const NumaExecutor&) = delete;
+
+    // дожидается уже поставленных запросов
+    ~NumaExecutor();
+
+    size_t GetNodeCount() const;
+
+    bool HasReplicas() const;
+
+    std::future<std::vector<Document>> Submit(std::string raw_query);
+
+    // то же, что ProcessQueries, но на потоках узлов
+    std::vector<std::vector<Document>> ProcessQueries(const std::vector<std::string>& queries);
+
+private:
+
+    using Task = std::function<void(const SearchServer&)>;
+
+    struct Node {
+        NumaNode topology;
+        std::unique_ptr<SearchServer> replica;
+        const SearchServer* search_server = nullptr; // replica или исходный сервер
+
+        std::mutex guard;
+        std::condition_variable has_tasks;
+        std::deque<Task> tasks;
+        std::atomic<size_t> queued{0}; // для выбора узла без захвата мьютексов
+        bool is_stopping = false;
+        std::vector<std::thread> workers;
+    };
+
+    void RunWorker(Node& node);
+
+    void Push(Node& node, Task task);
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+};
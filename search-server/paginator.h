@@ -1,6 +1,8 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
-#include <vector>
+#include <iterator>
+#include <type_traits>
 
 template <typename Iterator>
 class Page {
@@ -10,41 +12,85 @@ public:
 
     Iterator begin() const { return begin_; }
     Iterator end() const { return end_; }
-    int size() const { return distance(end_, begin_); }
+    int size() const { return std::distance(begin_, end_); }
 
 private:
-    const Iterator begin_;
-    const Iterator end_;
+    Iterator begin_;
+    Iterator end_;
 };
 
+// Страницы не хранятся, а вычисляются на ходу при обходе: конец страницы ищется сдвигом не более чем на page_size,
+// так что получение первых страниц не требует прохода по всему диапазону
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator(Iterator range_begin, Iterator range_end, int page_size) {
 
-        auto page_start = range_begin;
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Page<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Page<Iterator>*;
+        using reference = Page<Iterator>;
 
-        while (page_start != range_end) {
-            
-            auto page_end = page_start;
-            if (distance(page_start, range_end) >= page_size) {
-                advance(page_end, page_size);
+        PageIterator(Iterator page_begin, Iterator range_end, size_t page_size)
+            : page_begin_(page_begin)
+            , page_end_(FindPageEnd(page_begin, range_end, page_size))
+            , range_end_(range_end)
+            , page_size_(page_size) {
+        }
+
+        Page<Iterator> operator*() const { return Page(page_begin_, page_end_); }
+
+        PageIterator& operator++() {
+            page_begin_ = page_end_;
+            page_end_ = FindPageEnd(page_begin_, range_end_, page_size_);
+            return *this;
+        }
+
+        PageIterator operator++(int) {
+            PageIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PageIterator& other) const { return page_begin_ == other.page_begin_; }
+        bool operator!=(const PageIterator& other) const { return !(*this == other); }
+
+    private:
+        static Iterator FindPageEnd(Iterator page_begin, Iterator range_end, size_t page_size) {
+            using Category = typename std::iterator_traits<Iterator>::iterator_category;
+            if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+                const auto step = std::min<std::ptrdiff_t>(std::distance(page_begin, range_end), page_size);
+                return page_begin + step;
             } else {
-                page_end = range_end;
+                for (size_t i = 0; i < page_size && page_begin != range_end; ++i) {
+                    ++page_begin;
+                }
+                return page_begin;
             }
-
-            pages_.push_back(Page(page_start, page_end));
-            
-            page_start = page_end;
         }
+
+        Iterator page_begin_;
+        Iterator page_end_;
+        Iterator range_end_;
+        size_t page_size_;
+    };
+
+    Paginator(Iterator range_begin, Iterator range_end, size_t page_size)
+        : range_begin_(range_begin)
+        , range_end_(range_end)
+        , page_size_(std::max<size_t>(page_size, 1)) {
     }
 
-    auto begin() const { return pages_.begin(); }
+    PageIterator begin() const { return PageIterator(range_begin_, range_end_, page_size_); }
 
-    auto end() const { return pages_.end(); }
+    PageIterator end() const { return PageIterator(range_end_, range_end_, page_size_); }
 
 private:
-    std::vector<Page<Iterator>> pages_;
+    Iterator range_begin_;
+    Iterator range_end_;
+    size_t page_size_;
 };
 
 template <typename Container>
@@ -59,4 +105,4 @@ std::ostream& operator<<(std::ostream& output, const Page<Iterator>& page) {
     output << *it;
 
     return output;
-}
\ No newline at end of file
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include "positional_index.h"
+
+PositionalIndex::PositionalIndex(std::shared_ptr<MemoryCounter> counter /* = nullptr */,
+                                 std::pmr::memory_resource* resource /* = std::pmr::get_default_resource() */)
+    : positions_by_term_(CountingAllocator<char>(std::move(counter), resource)) {
+}
+
+void PositionalIndex::AddDocument(int internal_id, const std::vector<std::string_view>& words) {
+    std::map<std::string_view, uint32_t> last_positions;
+
+    for (uint32_t position = 0; position < words.size(); ++position) {
+        EncodedPositions& encoded = positions_by_term_[words[position]][internal_id];
+
+        // первая позиция пишется как есть, следующие -- разностью с предыдущей
+        const auto [last, is_first] = last_positions.emplace(words[position], position);
+        AppendVarint(encoded, is_first ? position : position - last->second);
+        last->second = position;
+    }
+}
+
+void PositionalIndex::RemoveDocument(int internal_id, const std::vector<std::string_view>& words) {
+    for (std::string_view word : words) {
+        const auto term = positions_by_term_.find(word);
+        if (term == positions_by_term_.end()) {
+            continue;
+        }
+
+        term->second.erase(internal_id);
+        if (term->second.empty()) {
+            positions_by_term_.erase(term);
+        }
+    }
+}
+
+void PositionalIndex::RemoveDocuments(const RemovedPostings& postings) {
+    auto term = positions_by_term_.end();
+    for (size_t i = 0; i < postings.size(); ++i) {
+        const auto& [word, internal_id] = postings[i];
+        if (i == 0 || word != postings[i - 1].first) {
+            term = positions_by_term_.find(word);
+        }
+        if (term == positions_by_term_.end()) {
+            continue;
+        }
+
+        term->second.erase(internal_id);
+        // следующее слово пачки другое -- опустевший список можно убрать
+        if (term->second.empty() && (i + 1 == postings.size() || postings[i + 1].first != word)) {
+            positions_by_term_.erase(term);
+            term = positions_by_term_.end();
+        }
+    }
+}
+
+std::vector<uint32_t> PositionalIndex::GetPositions(std::string_view word, int internal_id) const {
+    const auto term = positions_by_term_.find(word);
+    if (term == positions_by_term_.end()) {
+        return {};
+    }
+
+    const auto posting = term->second.find(internal_id);
+    if (posting == term->second.end()) {
+        return {};
+    }
+
+    return DecodePositions(posting->second);
+}
+
+std::vector<int> PositionalIndex::FindPhrase(const Phrase& phrase) const {
+    std::vector<const Postings*> postings;
+    for (std::string_view word : phrase.words) {
+        const auto term = positions_by_term_.find(word);
+        if (term == positions_by_term_.end()) {
+            return {};
+        }
+        postings.push_back(&term->second);
+    }
+
+    if (postings.empty()) {
+        return {};
+    }
+
+    // идем по самому короткому списку, остальные проверяем поиском
+    const Postings* shortest = *std::min_element(postings.begin(), postings.end(),
+                                                 [](const Postings* lhs, const Postings* rhs) { return lhs->size() < rhs->size(); });
+
+    std::vector<int> result;
+    for (const auto& [internal_id, _] : *shortest) {
+        const bool is_in_all = std::all_of(postings.begin(), postings.end(),
+                                           [internal_id = internal_id](const Postings* other) { return other->count(internal_id) > 0; });
+        if (is_in_all && MatchPositions(internal_id, postings, phrase.slop)) {
+            result.push_back(internal_id);
+        }
+    }
+
+    return result;
+}
+
+bool PositionalIndex::ContainsPhrase(int internal_id, const Phrase& phrase) const {
+    std::vector<const Postings*> postings;
+    for (std::string_view word : phrase.words) {
+        const auto term = positions_by_term_.find(word);
+        if (term == positions_by_term_.end() || term->second.count(internal_id) == 0) {
+            return false;
+        }
+        postings.push_back(&term->second);
+    }
+
+    return !postings.empty() && MatchPositions(internal_id, postings, phrase.slop);
+}
+
+void PositionalIndex::AppendVarint(EncodedPositions& output, uint32_t value) {
+    // по 7 бит на байт, старший бит -- "будет продолжение"
+    while (value >= 0x80) {
+        output.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<uint8_t>(value));
+}
+
+std::vector<uint32_t> PositionalIndex::DecodePositions(const EncodedPositions& encoded) {
+    std::vector<uint32_t> positions;
+    uint32_t position = 0;
+    uint32_t value = 0;
+    int shift = 0;
+
+    for (const uint8_t byte : encoded) {
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+
+        position = positions.empty() ? value : position + value;
+        positions.push_back(position);
+        value = 0;
+        shift = 0;
+    }
+
+    return positions;
+}
+
+bool PositionalIndex::MatchPositions(int internal_id, const std::vector<const Postings*>& postings, int slop) const {
+    std::vector<std::vector<uint32_t>> positions;
+    positions.reserve(postings.size());
+    for (const Postings* word_postings : postings) {
+        positions.push_back(DecodePositions(word_postings->at(internal_id)));
+    }
+
+    // от каждого вхождения первого слова жадно берем ближайшие следующие вхождения остальных слов:
+    // так конец фразы получается самым ранним, а значит и число слов-вставок -- наименьшим
+    for (const uint32_t start : positions[0]) {
+        uint32_t previous = start;
+        bool is_found = true;
+
+        for (size_t i = 1; i < positions.size(); ++i) {
+            const auto next = std::upper_bound(positions[i].begin(), positions[i].end(), previous);
+            if (next == positions[i].end()) {
+                return false; // дальше вхождений этого слова нет -- и от следующих start не будет
+            }
+            previous = *next;
+            if (previous - start - i > static_cast<uint32_t>(slop)) {
+                is_found = false;
+                break;
+            }
+        }
+
+        if (is_found) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+
+// фраза из запроса: слова в кавычках и допустимое число "лишних" слов между ними (slop, "a b"~2)
+struct Phrase {
+    std::vector<std::string_view> words;
+    int slop = 0;
+};
+
+// пары [слово -- внутренний id] вычеркнутых постингов; память считается счетчиком индекса, который их держит
+using RemovedPostings = std::vector<std::pair<std::string_view, int>, CountingAllocator<std::pair<std::string_view, int>>>;
+
+// Позиции слов в документах, хранится отдельно от TF-индекса и нужна только фразовым запросам.
+// Позиции слова в документе возрастают, поэтому храним разности соседних позиций в varint-кодировке:
+// для типичных текстов почти каждая позиция занимает один байт.
+class PositionalIndex {
+public:
+
+    // counter -- куда считать память индекса (nullptr -- не считать), resource -- откуда ее брать
+    explicit PositionalIndex(std::shared_ptr<MemoryCounter> counter = nullptr,
+                             std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // words -- слова документа без стоп-слов в порядке следования; позиция слова -- его номер в words
+    void AddDocument(int internal_id, const std::vector<std::string_view>& words);
+
+    // words -- любые слова документа, повторы допустимы
+    void RemoveDocument(int internal_id, const std::vector<std::string_view>& words);
+
+    // postings -- пары [слово -- внутренний id], сгруппированные по слову: каждое слово ищется один раз
+    void RemoveDocuments(const RemovedPostings& postings);
+
+    std::vector<uint32_t> GetPositions(std::string_view word, int internal_id) const;
+
+    // внутренние id документов (по возрастанию), где встречается фраза: сначала пересекаем списки документов
+    // всех слов фразы, и только у попавших в пересечение декодируем и сверяем позиции
+    std::vector<int> FindPhrase(const Phrase& phrase) const;
+
+    bool ContainsPhrase(int internal_id, const Phrase& phrase) const;
+
+private:
+
+    using EncodedPositions = std::vector<uint8_t, CountingAllocator<uint8_t>>;
+    using Postings = std::map<int, EncodedPositions, std::less<int>,
+                              ScopedCountingAllocator<std::pair<const int, EncodedPositions>>>; // внутренний id -- закодированные позиции
+
+    static void AppendVarint(EncodedPositions& output, uint32_t value);
+
+    static std::vector<uint32_t> DecodePositions(const EncodedPositions& encoded);
+
+    bool MatchPositions(int internal_id, const std::vector<const Postings*>& postings, int slop) const;
+
+    std::map<std::string_view, Postings, std::less<std::string_view>,
+             ScopedCountingAllocator<std::pair<const std::string_view, Postings>>> positions_by_term_;
+};
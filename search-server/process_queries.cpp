@@ -1,5 +1,7 @@
 #include <execution>
 #include <algorithm>
+#include <exception>
+#include <limits>
 #include <utility>
 #include <list>
 #include "process_queries.h"
@@ -32,3 +34,178 @@ std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, cons
 
     return result;
 }
+
+AdmissionExecutor::AdmissionExecutor(const SearchServer& search_server, const AdmissionLimits& limits)
+    : search_server_(search_server)
+    , limits_(limits) {
+    const size_t concurrency = limits_.max_concurrency > 0 ? limits_.max_concurrency : std::max(1u, std::thread::hardware_concurrency());
+    // глубина по умолчанию -- максимум size_t, сумма не должна переполниться
+    capacity_ = concurrency + std::min(limits_.max_queue_depth, std::numeric_limits<size_t>::max() - concurrency);
+
+    for (size_t i = 0; i < concurrency; ++i) {
+        workers_.emplace_back([this]() { RunWorker(); });
+    }
+}
+
+AdmissionExecutor::~AdmissionExecutor() {
+    {
+        std::lock_guard guard(guard_);
+        is_stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::future<ProcessedQuery> AdmissionExecutor::Submit(std::string raw_query) {
+    Task task;
+    task.raw_query = std::move(raw_query);
+    std::future<ProcessedQuery> result = task.promise.get_future();
+
+    // стоимость оценивается в вызывающем потоке и без блокировки: отброшенный по ней запрос места не занимает
+    if (limits_.max_cost != std::numeric_limits<uint64_t>::max()) {
+        try {
+            task.is_degraded = search_server_.EstimateQueryCost(task.raw_query) > limits_.max_cost;
+        } catch (...) {
+            task.promise.set_exception(std::current_exception());
+            return result;
+        }
+        if (task.is_degraded && limits_.expensive_query_policy == ExpensiveQueryPolicy::REJECT) {
+            ProcessedQuery processed;
+            processed.admission = QueryAdmission::SHED_TOO_EXPENSIVE;
+            {
+                std::lock_guard guard(guard_);
+                CountQuery(stats_, processed);
+            }
+            task.promise.set_value(std::move(processed));
+            return result;
+        }
+    }
+
+    {
+        std::lock_guard guard(guard_);
+        if (occupancy_ == capacity_) {
+            ProcessedQuery processed;
+            processed.admission = QueryAdmission::SHED_QUEUE_FULL;
+            CountQuery(stats_, processed);
+            task.promise.set_value(std::move(processed));
+            return result;
+        }
+        ++occupancy_;
+        tasks_.push_back(std::move(task));
+    }
+    has_tasks_.notify_one();
+
+    return result;
+}
+
+std::vector<ProcessedQuery> AdmissionExecutor::ProcessQueries(const std::vector<std::string>& queries, AdmissionStats* stats /* = nullptr */) {
+    std::vector<std::future<ProcessedQuery>> futures;
+    futures.reserve(queries.size());
+    for (const std::string& query : queries) {
+        futures.push_back(Submit(query));
+    }
+
+    // дожидаемся всех, даже если какой-то запрос неверный: future ошибки не должен пережить пачку
+    std::vector<ProcessedQuery> result(queries.size());
+    std::exception_ptr error;
+    for (size_t i = 0; i < futures.size(); ++i) {
+        try {
+            result[i] = futures[i].get();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (stats != nullptr) {
+        *stats = {};
+        for (const ProcessedQuery& processed : result) {
+            CountQuery(*stats, processed);
+        }
+    }
+
+    return result;
+}
+
+size_t AdmissionExecutor::GetOccupancy() const {
+    std::lock_guard guard(guard_);
+    return occupancy_;
+}
+
+AdmissionStats AdmissionExecutor::GetStats() const {
+    std::lock_guard guard(guard_);
+    return stats_;
+}
+
+void AdmissionExecutor::Pause() {
+    std::lock_guard guard(guard_);
+    is_paused_ = true;
+}
+
+void AdmissionExecutor::Resume() {
+    {
+        std::lock_guard guard(guard_);
+        is_paused_ = false;
+    }
+    has_tasks_.notify_all();
+}
+
+void AdmissionExecutor::CountQuery(AdmissionStats& stats, const ProcessedQuery& processed) {
+    switch (processed.admission) {
+        case QueryAdmission::EXECUTED: ++stats.executed; break;
+        case QueryAdmission::DEGRADED: ++stats.degraded; break;
+        case QueryAdmission::SHED_QUEUE_FULL: ++stats.shed_queue_full; break;
+        case QueryAdmission::SHED_TOO_EXPENSIVE: ++stats.shed_too_expensive; break;
+    }
+    stats.truncated += processed.is_truncated;
+}
+
+void AdmissionExecutor::RunWorker() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock lock(guard_);
+            has_tasks_.wait(lock, [this]() { return is_stopping_ || (!is_paused_ && !tasks_.empty()); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        ProcessedQuery processed;
+        std::exception_ptr error;
+        try {
+            if (task.is_degraded) {
+                SearchResult search_result = search_server_.FindTopDocumentsWithDeadline(task.raw_query, QueryDeadline::After(limits_.degraded_timeout));
+                processed.documents = std::move(search_result.documents);
+                processed.admission = QueryAdmission::DEGRADED;
+                processed.is_truncated = search_result.is_truncated;
+            } else {
+                processed.documents = search_server_.FindTopDocuments(task.raw_query);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // место освобождается до того, как вызывающий увидит результат: следующий его запрос уже допустим
+        {
+            std::lock_guard guard(guard_);
+            --occupancy_;
+            if (!error) {
+                CountQuery(stats_, processed);
+            }
+        }
+        if (error) {
+            task.promise.set_exception(error);
+        } else {
+            task.promise.set_value(std::move(processed));
+        }
+    }
+}
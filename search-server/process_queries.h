@@ -1,5 +1,14 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include <list>
 #include "search_server.h"
@@ -8,4 +17,100 @@
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+std::list<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// что делать с запросом, оценка стоимости которого выше max_cost
+enum class ExpensiveQueryPolicy {
+    REJECT,
+    DEGRADE, // выполнить со сроком degraded_timeout -- выдача может оказаться неполной
+};
+
+struct AdmissionLimits {
+    size_t max_concurrency = 0; // сколько запросов выполняется одновременно; 0 -- по числу ядер
+    size_t max_queue_depth = std::numeric_limits<size_t>::max(); // сколько допущенных запросов может ждать сверх выполняющихся
+    uint64_t max_cost = std::numeric_limits<uint64_t>::max(); // в постингах, см. SearchServer::EstimateQueryCost
+    ExpensiveQueryPolicy expensive_query_policy = ExpensiveQueryPolicy::REJECT;
+    std::chrono::steady_clock::duration degraded_timeout = std::chrono::milliseconds(10);
+};
+
+enum class QueryAdmission {
+    EXECUTED,
+    DEGRADED,
+    SHED_QUEUE_FULL,
+    SHED_TOO_EXPENSIVE,
+};
+
+struct ProcessedQuery {
+    std::vector<Document> documents; // у отброшенного запроса пусто
+    QueryAdmission admission = QueryAdmission::EXECUTED;
+    bool is_truncated = false; // деградировавший запрос не уложился в degraded_timeout
+};
+
+struct AdmissionStats {
+    uint64_t executed = 0;
+    uint64_t degraded = 0;
+    uint64_t truncated = 0;
+    uint64_t shed_queue_full = 0;
+    uint64_t shed_too_expensive = 0;
+};
+
+// Контроль допуска перед общим пулом из max_concurrency потоков: все вызывающие потоки ставят запросы через один
+// исполнитель, поэтому ни число одновременных поисков, ни очередь не растут с числом вызывающих.
+// Запрос сначала оценивается по длинам постингов -- дорогой отбрасывается или деградирует, -- затем допускается,
+// только если выполняющихся и ждущих запросов сейчас меньше max_concurrency + max_queue_depth; иначе он
+// отбрасывается сразу, не дожидаясь исполнителя. search_server должен пережить исполнитель и не меняться.
+class AdmissionExecutor {
+public:
+
+    AdmissionExecutor(const SearchServer& search_server, const AdmissionLimits& limits);
+
+    AdmissionExecutor(const AdmissionExecutor&) = delete;
+    AdmissionExecutor& operator=(const AdmissionExecutor&) = delete;
+
+    // дожидается уже допущенных запросов, даже если исполнитель приостановлен
+    ~AdmissionExecutor();
+
+    // отброшенный запрос возвращается уже готовым; неверный запрос бросает invalid_argument из future
+    std::future<ProcessedQuery> Submit(std::string raw_query);
+
+    // пачка запросов через Submit, stats -- по этой пачке; неверный запрос бросает invalid_argument,
+    // как и обычный ProcessQueries
+    std::vector<ProcessedQuery> ProcessQueries(const std::vector<std::string>& queries, AdmissionStats* stats = nullptr);
+
+    // сколько допущенных запросов сейчас выполняется или ждет
+    size_t GetOccupancy() const;
+
+    // по всем запросам исполнителя с его создания
+    AdmissionStats GetStats() const;
+
+    // приостановленный исполнитель допускает запросы, пока есть места, но не начинает новых -- например,
+    // на время замены индекса
+    void Pause();
+
+    void Resume();
+
+private:
+
+    struct Task {
+        std::string raw_query;
+        bool is_degraded = false;
+        std::promise<ProcessedQuery> promise;
+    };
+
+    static void CountQuery(AdmissionStats& stats, const ProcessedQuery& processed);
+
+    void RunWorker();
+
+    const SearchServer& search_server_;
+    const AdmissionLimits limits_;
+    size_t capacity_ = 0; // max_concurrency + max_queue_depth
+
+    mutable std::mutex guard_;
+    std::condition_variable has_tasks_;
+    std::deque<Task> tasks_;
+    size_t occupancy_ = 0; // допущенные: ждущие в tasks_ и выполняющиеся
+    bool is_paused_ = false;
+    bool is_stopping_ = false;
+    AdmissionStats stats_;
+    std::vector<std::thread> workers_;
+};
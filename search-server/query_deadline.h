@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// отмена запроса из другого потока: все копии токена смотрят на один флаг
+class CancellationToken {
+public:
+
+    CancellationToken() : is_cancelled_(std::make_shared<std::atomic<bool>>(false)) {
+    }
+
+    void Cancel() const {
+        is_cancelled_->store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return is_cancelled_->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> is_cancelled_;
+};
+
+// срок выполнения запроса; по умолчанию срока нет, остается только отмена
+struct QueryDeadline {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point time_point = Clock::time_point::max();
+    CancellationToken token;
+
+    static QueryDeadline After(Clock::duration timeout, CancellationToken token = {}) {
+        return {Clock::now() + timeout, std::move(token)};
+    }
+};
+
+// проверки срока в одном выполнении запроса; их делают между блоками постингов, а не на каждом постинге.
+// сработав один раз, дальше отвечает true, не трогая часы
+class QueryInterrupt {
+public:
+
+    // между проверками срока обрабатывается столько постингов
+    static const size_t CHECK_INTERVAL = 1024;
+
+    explicit QueryInterrupt(const QueryDeadline& deadline) : deadline_(deadline) {
+    }
+
+    bool ShouldStop() const {
+        if (is_stopped_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (deadline_.token.IsCancelled() || QueryDeadline::Clock::now() >= deadline_.time_point) {
+            is_stopped_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // запрос был прерван -- выдача неполная
+    bool IsStopped() const {
+        return is_stopped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    QueryDeadline deadline_;
+    mutable std::atomic<bool> is_stopped_{false};
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// статистика выполнения одного запроса; заполняется, только если в FindTopDocuments/MatchDocument передан указатель на нее
+struct QueryStats {
+    int plus_words = 0;
+    int plus_words_resolved = 0; // нашлись в индексе
+    int minus_words = 0;
+    int minus_words_resolved = 0;
+
+    uint64_t postings_scanned = 0;
+    uint64_t documents_scored = 0; // сколько документов набрали релевантность до вычеркивания минус-словами
+    uint64_t rejected_by_filter = 0; // постинги, отброшенные фильтром документов
+    uint64_t rejected_by_minus_words = 0;
+    uint64_t candidates_sorted = 0;
+
+    uint64_t parse_ns = 0;
+    uint64_t score_ns = 0;
+    uint64_t filter_ns = 0; // вычеркивание минус-словами
+    uint64_t sort_ns = 0;
+    uint64_t total_ns = 0;
+};
+
+// засекает время фазы и прибавляет его к *target; с target == nullptr не трогает часы вовсе
+class PhaseTimer {
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    explicit PhaseTimer(uint64_t* target) : target_(target) {
+        if (target_ != nullptr) {
+            start_time_ = Clock::now();
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    ~PhaseTimer() {
+        if (target_ != nullptr) {
+            *target_ += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count();
+        }
+    }
+
+private:
+    uint64_t* target_;
+    Clock::time_point start_time_;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// генераторы случайных словарей, документов и запросов для нагрузочных замеров
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+// отсортированный словарь без повторов; слов может оказаться меньше word_count
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+// с вероятностью minus_prob слово становится минус-словом
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
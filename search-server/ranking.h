@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+enum class RankingFunction {
+    TF_IDF,
+    BM25,
+};
+
+struct Bm25Params {
+    double k1 = 1.2; // насыщение частоты слова
+    double b = 0.75; // сила нормировки по длине документа
+};
+
+// Функции ранжирования подставляются в поиск параметром шаблона. ComputeIdf вызывается один раз на слово запроса,
+// у TF-IDF вклад постинга считается прямо при обходе, остальные функции получают постинги блоками по BLOCK_SIZE.
+
+// классический TF-IDF: TF -- доля слова в документе, посчитанная в AddDocument
+struct TfIdfRanking {
+    double ComputeIdf(size_t document_count, size_t document_freq) const {
+        return std::log(static_cast<double>(document_count) / document_freq);
+    }
+};
+
+// Okapi BM25. Частота слова в индексе хранится долей tf = f / length, поэтому формулу
+// idf * f * (k1 + 1) / (f + k1 * (1 - b + b * length / avg_length)) делим на length:
+// idf * (k1 + 1) * tf / (tf + norm), где norm = k1 * (1 - b + b * length / avg_length) / length
+// заранее посчитана для каждого документа и лежит в плотной колонке по внутреннему id
+class Bm25Ranking {
+public:
+
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    Bm25Ranking(Bm25Params params, std::shared_ptr<const std::vector<double>> length_norms)
+        : params_(params)
+        , length_norms_(std::move(length_norms)) {
+    }
+
+    double ComputeIdf(size_t document_count, size_t document_freq) const {
+        // вариант с +1 под логарифмом: слово, которое есть почти во всех документах, не дает отрицательного вклада
+        return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+    // scores[i] -- вклад слова с данным idf в документ internal_ids[i] с долей слова term_frequencies[i];
+    // нормы сначала собираются в подряд идущий буфер, после чего основной цикл без ветвлений векторизуется
+    void ScoreBlock(double idf, const int* internal_ids, const double* term_frequencies, double* scores, size_t count) const {
+        const double* length_norms = length_norms_->data();
+        double norms[BLOCK_SIZE];
+        for (size_t i = 0; i < count; ++i) {
+            norms[i] = length_norms[internal_ids[i]];
+        }
+
+        const double numerator = idf * (params_.k1 + 1);
+        for (size_t i = 0; i < count; ++i) {
+            scores[i] = numerator * term_frequencies[i] / (term_frequencies[i] + norms[i]);
+        }
+    }
+
+private:
+    Bm25Params params_;
+    std::shared_ptr<const std::vector<double>> length_norms_;
+};
@@ -1,29 +1,123 @@
+#include <algorithm>
+
 #include "request_queue.h"
 #include "search_server.h"
 
-RequestQueue::RequestQueue(const SearchServer& search_server) : search_s_(search_server) {}
+RequestQueue::RequestQueue(const SearchServer& search_server, size_t capacity /* = DEFAULT_CAPACITY */)
+    : search_s_(search_server)
+    , slots_(std::max<size_t>(capacity, 1)) {
+}
 
 // о, прикольно; параметр по умолчанию есть в объявлении -- следовательно в определении не нужен! иначе ошибка "default argument given for parameter"
 // для прозрачности можно закомментить
 std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus given_status /* = DocumentStatus::ACTUAL */) {
-    return AddFindRequest(raw_query, [given_status](int document_id, DocumentStatus status, int rating) {return status == given_status;});
+    return AddFindRequest(raw_query, StatusIn({given_status}));
 }
 
-int RequestQueue::GetNoResultRequests() const {
-    return empty_requests_;
+void RequestQueue::RecordRequest(size_t result_count, Clock::duration latency, Clock::time_point request_time) {
+    const uint64_t ticket = next_ticket_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[ticket % slots_.size()];
+
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // номер берется по завершении запроса, поэтому и время -- завершения: тогда записи идут по времени почти так же,
+    // как по номерам (с точностью до ORDER_SLACK между замером и fetch_add). Время начала долгого запроса,
+    // закончившегося последним, раньше, чем у всех записей до него
+    const Clock::time_point completion_time = request_time + latency;
+    slot.time_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(completion_time.time_since_epoch()).count(), std::memory_order_relaxed);
+    slot.latency_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count(), std::memory_order_relaxed);
+    slot.result_count.store(result_count, std::memory_order_relaxed);
+
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
 }
 
-void RequestQueue::QueryRevision(std::deque<QueryResult>& requests, const QueryResult& res) {
-    requests.push_back(res);
-    if (res.content.empty()) {
-        ++empty_requests_;
+bool RequestQueue::ReadRecord(uint64_t ticket, RequestRecord& record) const {
+    const Slot& slot = slots_[ticket % slots_.size()];
+
+    const uint64_t expected_sequence = 2 * ticket + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected_sequence) {
+        return false;
+    }
+
+    record.time_ns = slot.time_ns.load(std::memory_order_relaxed);
+    record.latency_ns = slot.latency_ns.load(std::memory_order_relaxed);
+    record.result_count = slot.result_count.load(std::memory_order_relaxed);
+
+    // пока читали, слот могли начать перезаписывать -- тогда прочитанное не годится
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected_sequence;
+}
+
+int RequestQueue::GetNoResultRequests() const {
+    const uint64_t end_ticket = next_ticket_.load(std::memory_order_acquire);
+    const uint64_t depth = std::min<uint64_t>({end_ticket, min_in_day_, slots_.size()});
+
+    int empty_requests = 0;
+    RequestRecord record;
+    for (uint64_t ticket = end_ticket - depth; ticket < end_ticket; ++ticket) {
+        if (ReadRecord(ticket, record) && record.result_count == 0) {
+            ++empty_requests;
+        }
     }
 
-    if (requests.size() > min_in_day_) {
-        if (requests.front().content.empty()) {
-            --empty_requests_;
+    return empty_requests;
+}
+
+RequestStatistics RequestQueue::GetStatistics(Clock::duration window, Clock::time_point now /* = Clock::now() */) const {
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    const int64_t window_start_ns = now_ns - std::chrono::duration_cast<std::chrono::nanoseconds>(window).count();
+    const int64_t scan_start_ns = window_start_ns - std::chrono::duration_cast<std::chrono::nanoseconds>(ORDER_SLACK).count();
+
+    const uint64_t end_ticket = next_ticket_.load(std::memory_order_acquire);
+    const uint64_t depth = std::min<uint64_t>(end_ticket, slots_.size());
+
+    RequestStatistics statistics;
+    std::vector<uint64_t> latencies;
+    int64_t oldest_time_ns = now_ns;
+    bool is_window_start_reached = false;
+
+    // идем от свежих запросов к старым, пока не выйдем за начало окна с запасом ORDER_SLACK: записи упорядочены
+    // по времени завершения лишь с этой точностью, и запись чуть раньше окна еще не значит, что раньше нее в окне никого
+    RequestRecord record;
+    for (uint64_t i = 1; i <= depth; ++i) {
+        if (!ReadRecord(end_ticket - i, record) || record.time_ns > now_ns) {
+            continue;
+        }
+        if (record.time_ns < scan_start_ns) {
+            is_window_start_reached = true;
+            break;
+        }
+        if (record.time_ns < window_start_ns) {
+            continue;
         }
 
-        requests.pop_front();
+        ++statistics.requests;
+        statistics.empty_results += record.result_count == 0;
+        latencies.push_back(record.latency_ns);
+        oldest_time_ns = std::min(oldest_time_ns, record.time_ns);
     }
-}
\ No newline at end of file
+
+    statistics.is_window_truncated = !is_window_start_reached && end_ticket > slots_.size();
+    if (statistics.requests == 0) {
+        return statistics;
+    }
+
+    statistics.empty_result_rate = static_cast<double>(statistics.empty_results) / statistics.requests;
+
+    const int64_t covered_ns = statistics.is_window_truncated ? now_ns - oldest_time_ns : now_ns - window_start_ns;
+    if (covered_ns > 0) {
+        statistics.queries_per_second = statistics.requests * 1e9 / covered_ns;
+    }
+
+    auto percentile = [&latencies](double quantile) {
+        auto nth = latencies.begin() + static_cast<size_t>(quantile * (latencies.size() - 1));
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return *nth;
+    };
+    statistics.latency_p50_ns = percentile(0.5);
+    statistics.latency_p99_ns = percentile(0.99);
+    statistics.latency_max_ns = *std::max_element(latencies.begin(), latencies.end());
+
+    return statistics;
+}
@@ -1,38 +1,83 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <deque>
 #include "document.h"
 #include "search_server.h"
 
+struct RequestStatistics {
+    uint64_t requests = 0;
+    uint64_t empty_results = 0;
+    double empty_result_rate = 0;
+    double queries_per_second = 0;
+    uint64_t latency_p50_ns = 0;
+    uint64_t latency_p99_ns = 0;
+    uint64_t latency_max_ns = 0;
+    // кольцевой буфер уже перезаписан раньше начала окна -- статистика только по сохранившейся части
+    bool is_window_truncated = false;
+};
+
+// Собирает статистику запросов к серверу. Хранит не выдачу, а компактную запись о каждом запросе
+// в кольцевом буфере фиксированного размера; писать и читать можно из нескольких потоков без блокировок.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+
+    using Clock = std::chrono::steady_clock;
+
+    static const size_t DEFAULT_CAPACITY = 1 << 17;
+
+    // насколько время завершения записи может отставать от более ранних по номеру: время замеряется до того,
+    // как запись берет номер, и параллельные писатели могут лечь в буфер не в том порядке
+    static constexpr Clock::duration ORDER_SLACK = std::chrono::seconds(1);
+
+    explicit RequestQueue(const SearchServer& search_server, size_t capacity = DEFAULT_CAPACITY);
 
     // сделаем "обёртки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate) {
-        
-        QueryResult search_result = {search_s_.FindTopDocuments(raw_query, document_predicate)};
-        QueryRevision(requests_, search_result);
+        const Clock::time_point start_time = Clock::now();
+        std::vector<Document> search_result = search_s_.FindTopDocuments(raw_query, document_predicate);
+        RecordRequest(search_result.size(), Clock::now() - start_time, start_time);
 
-        return search_result.content;
+        return search_result;
     }
 
     std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentStatus given_status = DocumentStatus::ACTUAL);
 
+    // записывает запрос, начатый в request_time, в статистику; AddFindRequest вызывает его сам.
+    // Вызывается по завершении запроса: запрос попадает в окно по времени завершения request_time + latency
+    void RecordRequest(size_t result_count, Clock::duration latency, Clock::time_point request_time);
+
+    // сколько из последних min_in_day_ запросов вернули пустую выдачу
     int GetNoResultRequests() const;
 
+    // статистика по запросам, завершившимся не раньше now - window; записи до начала окна не больше чем
+    // на ORDER_SLACK пропускаются, а не обрывают просмотр
+    RequestStatistics GetStatistics(Clock::duration window, Clock::time_point now = Clock::now()) const;
+
 private:
 
-    struct QueryResult {
-        std::vector<Document> content;
+    struct RequestRecord {
+        int64_t time_ns = 0; // время завершения запроса
+        uint64_t latency_ns = 0;
+        uint64_t result_count = 0;
+    };
+
+    // seqlock на слот: нечетный sequence -- запись идет, четный 2 * (ticket + 1) -- в слоте лежит запрос номер ticket
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<int64_t> time_ns{0};
+        std::atomic<uint64_t> latency_ns{0};
+        std::atomic<uint64_t> result_count{0};
     };
 
-    void QueryRevision(std::deque<QueryResult>& requests, const QueryResult& res);
+    // false, если запрос ticket уже перезаписан или еще дописывается
+    bool ReadRecord(uint64_t ticket, RequestRecord& record) const;
 
-    std::deque<QueryResult> requests_;
     const static int min_in_day_ = 1440;
-    int empty_requests_ = 0;
     const SearchServer& search_s_;
-};
\ No newline at end of file
+    std::vector<Slot> slots_;
+    std::atomic<uint64_t> next_ticket_{0};
+};
@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include "scratch_arena.h"
+
+ScratchArena::Scope::Scope() : arena_(ScratchArena::ForCurrentThread()) {
+    ++arena_.depth_;
+}
+
+ScratchArena::Scope::~Scope() {
+    if (--arena_.depth_ == 0) {
+        arena_.Reset();
+    }
+}
+
+std::pmr::memory_resource* ScratchArena::Scope::GetResource() const {
+    return &*arena_.resource_;
+}
+
+ScratchArena& ScratchArena::ForCurrentThread() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+size_t ScratchArena::GetCapacity() const {
+    return capacity_;
+}
+
+ScratchArena::ScratchArena()
+    : buffer_(new std::byte[capacity_]) {
+    resource_.emplace(buffer_.get(), capacity_, &overflow_);
+}
+
+void ScratchArena::Reset() {
+    // сначала отдаем переполнение, потом, если оно было, растим буфер так, чтобы такой запрос в следующий раз уместился
+    resource_.reset();
+    if (overflow_.allocated > 0 && capacity_ < MAX_CAPACITY) {
+        capacity_ = std::min(capacity_ + overflow_.allocated, MAX_CAPACITY);
+        buffer_.reset(new std::byte[capacity_]);
+    }
+    overflow_.allocated = 0;
+    resource_.emplace(buffer_.get(), capacity_, &overflow_);
+}
+
+void* ScratchArena::OverflowResource::do_allocate(size_t bytes, size_t alignment) {
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void ScratchArena::OverflowResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool ScratchArena::OverflowResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// Арена для временных данных запросов одного потока: монотонный ресурс поверх собственного буфера.
+// Пока открыт хотя бы один Scope, память только выделяется; закрытие внешнего Scope сбрасывает арену целиком.
+// Если запрос не уместился в буфер, при сбросе буфер вырастает до пикового объема (но не больше MAX_CAPACITY),
+// так что в установившемся режиме запросы не обращаются к malloc
+class ScratchArena {
+public:
+
+    static constexpr size_t INITIAL_CAPACITY = 64 * 1024;
+    static constexpr size_t MAX_CAPACITY = 16 * 1024 * 1024;
+
+    // Scope на арене текущего потока; вложенные Scope делят одну арену, сбрасывает ее только внешний.
+    // память из GetResource действительна, пока жив внешний Scope
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        std::pmr::memory_resource* GetResource() const;
+
+    private:
+        ScratchArena& arena_;
+    };
+
+    static ScratchArena& ForCurrentThread();
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    size_t GetCapacity() const;
+
+private:
+
+    // берет память, не уместившуюся в буфер, и помнит, сколько взято с последнего сброса
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t allocated = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    ScratchArena();
+
+    void Reset();
+
+    size_t capacity_ = INITIAL_CAPACITY;
+    std::unique_ptr<std::byte[]> buffer_;
+    OverflowResource overflow_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+    int depth_ = 0;
+};
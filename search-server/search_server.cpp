@@ -1,26 +1,74 @@
 #include <algorithm>
+#include <atomic>
 #include <set>
 #include <map>
 #include <list>
 #include <string>
 #include <utility>
 #include <execution>
+#include <charconv>
 
 #include <iostream>
 
 #include "search_server.h"
 
-std::set<int>::const_iterator SearchServer::begin() const {
-    return document_order_.begin();
+namespace {
+
+// эпохи индекса общие для всех серверов: запрос, подготовленный одним сервером, устарел для любого другого
+std::atomic<uint64_t> next_index_epoch{1};
+
+} // namespace
+
+DocumentIds::const_iterator SearchServer::begin() const {
+    return GetDocumentOrder()->ids.begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
-    return document_order_.end();
+DocumentIds::const_iterator SearchServer::end() const {
+    return GetDocumentOrder()->ids.end();
 }
 
-SearchServer::SearchServer(const std::string& stop_words_text) : SearchServer(std::string_view(stop_words_text)) {}
+SearchServer::SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* resource /* = std::pmr::get_default_resource() */)
+    : SearchServer(std::string_view(stop_words_text), resource) {}
+
+SearchServer::SearchServer(std::string_view stop_words_text, std::pmr::memory_resource* resource /* = std::pmr::get_default_resource() */)
+    : SearchServer(SplitIntoWordsView(stop_words_text), resource) {}
+
+SearchServer::SearchServer(const SearchServer& other) : SearchServer(other, std::pmr::get_default_resource()) {}
+
+SearchServer::SearchServer(const SearchServer& other, std::pmr::memory_resource* resource)
+    : memory_resource_(resource)
+    , memory_budget_(other.memory_budget_)
+    , memory_budget_policy_(other.memory_budget_policy_)
+    , stop_words_(other.stop_words_)
+    , fuzzy_distance_(other.fuzzy_distance_)
+    , synonyms_(other.synonyms_)
+    , synonym_weight_(other.synonym_weight_)
+    , ranking_function_(other.ranking_function_)
+    , bm25_params_(other.bm25_params_) {
 
-SearchServer::SearchServer(std::string_view stop_words_text) : SearchServer(SplitIntoWordsView(stop_words_text)) {}
+    if (other.positional_index_) {
+        positional_index_.emplace(positional_index_memory_, node_pool_.get());
+    }
+
+    // текст недочищенного документа остается в колонке -- по нему надгробие строится заново
+    std::vector<bool> is_unpurged(other.external_ids_.size());
+    for (const int internal_id : other.unpurged_documents_) {
+        is_unpurged[internal_id] = true;
+    }
+
+    // в порядке добавления, чтобы порядок постингов и позиций совпал с оригиналом; надгробие удаляется сразу после
+    // добавления, раньше, чем его внешний id мог бы занять более поздний документ
+    for (int internal_id = 0; internal_id < static_cast<int>(other.external_ids_.size()); ++internal_id) {
+        if (!other.IsLiveDocument(internal_id) && !is_unpurged[internal_id]) {
+            continue;
+        }
+        const int document_id = other.external_ids_[internal_id];
+        IndexDocument(document_id, other.document_texts_[internal_id], other.statuses_[internal_id], other.ratings_[internal_id]);
+        if (is_unpurged[internal_id]) {
+            TombstoneDocument(document_id, internal_ids_.Find(document_id));
+        }
+    }
+}
 
 void SearchServer::AddDocument(int document_id, std::string_view document, const DocumentStatus& status, const std::vector<int>& ratings) {
     
@@ -34,32 +82,241 @@ void SearchServer::AddDocument(int document_id, std::string_view document, const
         throw std::invalid_argument("Recurring document id"s);
     }
 
-    // наполняем счетчик документов -- он пригодится для подсчета IDF.
-    // одновременно и порядок добавления получаем
-    document_order_.insert(document_id); 
+    CheckMemoryBudget(document.size());
+
+    IndexDocument(document_id, document, status, ComputeAverageRating(ratings));
+}
+
+void SearchServer::UpdateDocument(int document_id, std::string_view document) {
+    ThrowSpecialSymbolInText(document);
+
+    if (IsNegativeDocumentId(document_id)) {
+        throw std::invalid_argument("Negative document id"s);
+    }
+
+    if (IsNonExistentDocumentId(document_id)) {
+        throw std::invalid_argument("Nonexistent document id"s);
+    }
+
+    // бюджет проверяется до поиска внутреннего id: политика COMPACT перенумеровывает документы
+    CheckMemoryBudget(document.size());
+
+    const int internal_id = GetInternalId(document_id);
+    all_data_.emplace_back(document);
+    document_texts_[internal_id] = all_data_.back();
+
+    const std::vector<std::string_view> words = SplitIntoWordsNoStopView(document_texts_[internal_id]);
+    // TF считается так же, как в IndexDocument, -- до бита совпадает с TF заново добавленного документа
+    std::map<std::string_view, double> new_frequencies;
+    for (std::string_view word : words) {
+        new_frequencies[word] += 1.0 / words.size();
+    }
+
+    WordFrequencies& frequencies = document_words_[internal_id];
+    std::vector<std::string_view> old_words;
+    old_words.reserve(frequencies.size());
+    std::vector<std::string_view> added_terms;
+    size_t removed_term_count = 0;
+
+    // пропавшие слова
+    for (auto it = frequencies.begin(); it != frequencies.end();) {
+        old_words.push_back(it->first);
+        if (new_frequencies.count(it->first) > 0) {
+            ++it;
+            continue;
+        }
+
+        TermPostings& postings = *TF_by_term_.Find(it->first);
+        postings.erase(internal_id);
+        if (postings.empty()) {
+            TF_by_term_.Erase(it->first);
+            ++removed_term_count;
+        }
+        it = frequencies.erase(it);
+    }
+
+    // новые слова и слова с другим TF
+    for (const auto& [word, tf] : new_frequencies) {
+        const auto [it, is_inserted] = frequencies.emplace(word, tf);
+        if (!is_inserted) {
+            if (it->second == tf) {
+                continue;
+            }
+            it->second = tf;
+        }
+
+        TermPostings& postings = TF_by_term_[word];
+        if (postings.empty()) {
+            added_terms.push_back(word);
+        }
+        postings[internal_id] = tf;
+    }
+
+    // позиции сдвигаются от любой правки, поэтому индекс позиций документа строится заново
+    if (positional_index_) {
+        positional_index_->RemoveDocument(internal_id, old_words);
+        positional_index_->AddDocument(internal_id, words);
+    }
+
+    total_document_length_ += words.size();
+    total_document_length_ -= document_lengths_[internal_id];
+    document_lengths_[internal_id] = words.size();
+    length_norms_.reset();
+    UpdateTermDictionary(std::move(added_terms), removed_term_count);
+    index_epoch_ = NextIndexEpoch();
+}
+
+void SearchServer::UpdateDocumentAttributes(int document_id, DocumentStatus status, const std::vector<int>& ratings) {
+    if (IsNegativeDocumentId(document_id)) {
+        throw std::invalid_argument("Negative document id"s);
+    }
+
+    if (IsNonExistentDocumentId(document_id)) {
+        throw std::invalid_argument("Nonexistent document id"s);
+    }
+
+    const int internal_id = GetInternalId(document_id);
+    const DocumentStatus old_status = statuses_[internal_id];
+    status_bitmaps_[static_cast<int>(old_status)].Reset(internal_id);
+    --status_counts_[static_cast<int>(old_status)];
+    status_bitmaps_[static_cast<int>(status)].Set(internal_id);
+    ++status_counts_[static_cast<int>(status)];
 
-    document_info_[document_id] = {ComputeAverageRating(ratings), status};
+    statuses_[internal_id] = status;
+    ratings_[internal_id] = ComputeAverageRating(ratings);
+}
+
+void SearchServer::IndexDocument(int document_id, std::string_view document, DocumentStatus status, int rating) {
+    // внутренний id -- следующая свободная строка в колонках атрибутов
+    const int internal_id = external_ids_.size();
+    internal_ids_.Insert(document_id, internal_id);
+    external_ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+    for (Bitmap& status_bitmap : status_bitmaps_) {
+        status_bitmap.Resize(internal_id + 1);
+    }
+    status_bitmaps_[static_cast<int>(status)].Set(internal_id);
+    ++status_counts_[static_cast<int>(status)];
 
-    all_data_.push_back(static_cast<std::string>(document));
+    all_data_.emplace_back(document);
+    document_texts_.push_back(all_data_.back());
+    WordFrequencies& frequencies = document_words_.emplace_back();
 
-    const std::vector<std::string_view> words = SplitIntoWordsNoStopView(all_data_.back());
+    const std::vector<std::string_view> words = SplitIntoWordsNoStopView(document_texts_[internal_id]);
 
+    document_lengths_.push_back(words.size());
+    total_document_length_ += words.size();
+    length_norms_.reset();
+
+    std::vector<std::string_view> added_terms;
     for (std::string_view word : words) {
-        TF_by_term_[word][document_id] += 1.0 / words.size(); // Рассчитываем TF каждого слова в каждом документе.
-        TF_by_id_[document_id][word] += 1.0 / words.size();
+        TermPostings& postings = TF_by_term_[word];
+        if (postings.empty()) {
+            added_terms.push_back(word);
+        }
+        postings[internal_id] += 1.0 / words.size(); // Рассчитываем TF каждого слова в каждом документе.
+        frequencies[word] += 1.0 / words.size();
+    }
+    UpdateTermDictionary(std::move(added_terms), 0);
+
+    if (positional_index_) {
+        positional_index_->AddDocument(internal_id, words);
+    }
+
+    index_epoch_ = NextIndexEpoch();
+}
+
+void SearchServer::EnablePositionalIndex() {
+    if (positional_index_) {
+        return;
+    }
+
+    positional_index_.emplace(positional_index_memory_, node_pool_.get());
+    for (int internal_id = 0; internal_id < static_cast<int>(external_ids_.size()); ++internal_id) {
+        if (IsLiveDocument(internal_id)) {
+            positional_index_->AddDocument(internal_id, SplitIntoWordsNoStopView(document_texts_[internal_id]));
+        }
     }
+    index_epoch_ = NextIndexEpoch();
+}
+
+bool SearchServer::IsPositionalIndexEnabled() const {
+    return positional_index_.has_value();
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus given_status /* = DocumentStatus::ACTUAL */) const {
-    return FindTopDocuments(raw_query,
-                            [given_status](int document_id, DocumentStatus status, int rating) {
-                                return status == given_status;
-                            });
+void SearchServer::SetFuzzyDistance(int max_distance) {
+    if (max_distance < 0 || max_distance > 2) {
+        throw std::invalid_argument("Fuzzy distance must be from 0 to 2"s);
+    }
+    fuzzy_distance_ = max_distance;
+    index_epoch_ = NextIndexEpoch();
 }
 
-Matching SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+int SearchServer::GetFuzzyDistance() const {
+    return fuzzy_distance_;
+}
+
+void SearchServer::SetSynonyms(SynonymGraph synonyms, double weight /* = 0.5 */) {
+    if (!(weight > 0 && weight <= 1)) {
+        throw std::invalid_argument("Synonym weight must be in (0, 1]"s);
+    }
+    synonyms_ = std::move(synonyms);
+    synonym_weight_ = weight;
+    index_epoch_ = NextIndexEpoch();
+}
+
+const SynonymGraph& SearchServer::GetSynonyms() const {
+    return synonyms_;
+}
+
+void SearchServer::SetRankingFunction(RankingFunction ranking_function, Bm25Params params /* = {} */) {
+    if (params.k1 < 0 || params.b < 0 || params.b > 1) {
+        throw std::invalid_argument("BM25 parameters must satisfy k1 >= 0 and 0 <= b <= 1"s);
+    }
+    ranking_function_ = ranking_function;
+    bm25_params_ = params;
+    length_norms_.reset();
+}
+
+RankingFunction SearchServer::GetRankingFunction() const {
+    return ranking_function_;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus given_status /* = DocumentStatus::ACTUAL */, QueryStats* stats /* = nullptr */) const {
+    return FindTopDocumentsByFilter(std::execution::seq, raw_query, MakeColumnFilter(StatusIn({given_status})), stats);
+}
+
+SearchResult SearchServer::FindTopDocumentsWithDeadline(std::string_view raw_query, const QueryDeadline& deadline, DocumentStatus given_status /* = DocumentStatus::ACTUAL */) const {
+    return FindTopDocumentsWithDeadline(raw_query, deadline, StatusIn({given_status}));
+}
+
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(std::string_view raw_query, QueryDeadline deadline /* = {} */, DocumentStatus given_status /* = DocumentStatus::ACTUAL */) const {
+    return FindTopDocumentsAsync(raw_query, std::move(deadline), StatusIn({given_status}));
+}
+
+SearchPage SearchServer::FindTopDocumentsAfter(std::string_view raw_query, const std::optional<SearchCursor>& cursor, int page_size, DocumentStatus given_status /* = DocumentStatus::ACTUAL */) const {
+    return FindPageByFilter(raw_query, cursor, page_size, MakeColumnFilter(StatusIn({given_status})));
+}
+
+bool SearchServer::IsBeforeInResults(const Document& lhs, const Document& rhs) {
+    if (lhs.relevance != rhs.relevance) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+Matching SearchServer::MatchDocument(std::string_view raw_query, int document_id, QueryStats* stats /* = nullptr */) const {
+    TRACE_SPAN(TraceSpan::MATCH_DOCUMENT);
+
+    if (stats != nullptr) {
+        *stats = {};
+    }
+    PhaseTimer total_timer(stats != nullptr ? &stats->total_ns : nullptr);
 
-    
     ThrowSpecialSymbolInText(raw_query);
 
     if (IsNegativeDocumentId(document_id)) {
@@ -70,23 +327,43 @@ Matching SearchServer::MatchDocument(std::string_view raw_query, int document_id
         throw std::invalid_argument("Nonexistent document id"s);
     }
 
-    SearchServer::PlusMinusWords prepared_query = ParseQuery(raw_query /* is_parallel_need = false */);
+    SearchServer::PlusMinusWords prepared_query;
+    {
+        PhaseTimer parse_timer(stats != nullptr ? &stats->parse_ns : nullptr);
+        prepared_query = ParseQuery(raw_query /* is_parallel_need = false */);
+    }
+
+    return MatchParsedQuery(prepared_query, document_id, stats);
+}
+
+Matching SearchServer::MatchParsedQuery(PlusMinusWords& prepared_query, int document_id, QueryStats* stats) const {
+    CountResolvedWords(prepared_query, stats);
+    ExpandQueryToWords(prepared_query);
+
+    const int internal_id = GetInternalId(document_id);
 
     for (std::string_view minus_word : prepared_query.minus_words) {
-        if (TF_by_term_.count(minus_word) > 0) {
-            if (TF_by_term_.at(minus_word).count(document_id) > 0) {
-                return {std::vector<std::string_view>{}, document_info_.at(document_id).status};
+        const TermPostings* postings = TF_by_term_.Find(minus_word);
+        if (postings != nullptr && postings->count(internal_id) > 0) {
+            if (stats != nullptr) {
+                stats->rejected_by_minus_words = 1;
             }
+            return {std::vector<std::string_view>{}, statuses_[internal_id]};
+        }
+    }
+
+    for (const Phrase& phrase : prepared_query.phrases) {
+        if (!positional_index_->ContainsPhrase(internal_id, phrase)) {
+            return {std::vector<std::string_view>{}, statuses_[internal_id]};
         }
     }
 
     std::set<std::string_view> plus_words_in_document;
 
     for (std::string_view plus_word : prepared_query.plus_words) {
-        if (TF_by_term_.count(plus_word) == 1) {
-            if (TF_by_term_.at(plus_word).count(document_id) == 1) {
-                plus_words_in_document.insert(plus_word);
-            }
+        const TermPostings* postings = TF_by_term_.Find(plus_word);
+        if (postings != nullptr && postings->count(internal_id) == 1) {
+            plus_words_in_document.insert(plus_word);
         }
     }
 
@@ -95,14 +372,20 @@ Matching SearchServer::MatchDocument(std::string_view raw_query, int document_id
         result_intersection.push_back(word);
     }
 
-    return {result_intersection, document_info_.at(document_id).status};
+    return {result_intersection, statuses_[GetInternalId(document_id)]};
 }
 
-Matching SearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const {
-    return MatchDocument(raw_query, document_id);
+Matching SearchServer::MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id, QueryStats* stats /* = nullptr */) const {
+    return MatchDocument(raw_query, document_id, stats);
 }
 
-Matching SearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const {
+Matching SearchServer::MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id, QueryStats* stats /* = nullptr */) const {
+    TRACE_SPAN(TraceSpan::MATCH_DOCUMENT);
+
+    if (stats != nullptr) {
+        *stats = {};
+    }
+    PhaseTimer total_timer(stats != nullptr ? &stats->total_ns : nullptr);
 
     if (IsNegativeDocumentId(document_id)) {
         throw std::invalid_argument("Negative document id"s);
@@ -116,7 +399,11 @@ Matching SearchServer::MatchDocument(std::execution::parallel_policy, std::strin
     // true, потому что это параллельная версия MatchDocument; а параллельной MatchDocument
     // параллельная ParseQuery, которая запускается вторым параметром, установленным в true
 
-    SearchServer::PlusMinusWords prepared_query = ParseQuery(raw_query, true);
+    SearchServer::PlusMinusWords prepared_query;
+    {
+        PhaseTimer parse_timer(stats != nullptr ? &stats->parse_ns : nullptr);
+        prepared_query = ParseQuery(raw_query, true);
+    }
 
     auto find_word = [this, document_id](std::string_view word) {
                         return this->GetWordFrequencies(document_id).count(word);
@@ -126,15 +413,41 @@ Matching SearchServer::MatchDocument(std::execution::parallel_policy, std::strin
                                              prepared_query.minus_words.begin(), prepared_query.minus_words.end(),
                                              find_word);
 
+    is_minus_words_in_document = is_minus_words_in_document
+                                 || any_of(prepared_query.minus_patterns.begin(), prepared_query.minus_patterns.end(),
+                                           [this, &find_word](std::string_view pattern) {
+                                               const std::vector<std::string_view> words = this->ExpandPattern(pattern, this->TF_by_term_.Size());
+                                               return any_of(words.begin(), words.end(), find_word);
+                                           });
+
+    const DocumentStatus status = statuses_[GetInternalId(document_id)];
+
     if (is_minus_words_in_document) {
-        return {std::vector<std::string_view>{}, document_info_.at(document_id).status};
+        CountResolvedWords(prepared_query, stats);
+        if (stats != nullptr) {
+            stats->rejected_by_minus_words = 1;
+        }
+        return {std::vector<std::string_view>{}, status};
+    }
+
+    for (const Phrase& phrase : prepared_query.phrases) {
+        if (!positional_index_->ContainsPhrase(GetInternalId(document_id), phrase)) {
+            CountResolvedWords(prepared_query, stats);
+            return {std::vector<std::string_view>{}, status};
+        }
     }
 
     // очистим от повторов, а то повторы не свое место займут, которое резервится в result_intersection
     // тогда параллельный алгоритм начнет добавлять элементы и все упадет -- segmentation fault будет
     prepared_query.RemovePlusWordsDublicates();
+    CountResolvedWords(prepared_query, stats);
 
-    std::vector<std::string_view> result_intersection(TF_by_id_.at(document_id).size());
+    if (!prepared_query.plus_patterns.empty() || !prepared_query.fuzzy_words.empty() || !prepared_query.synonym_words.empty()) {
+        ExpandQueryToWords(prepared_query);
+        prepared_query.RemovePlusWordsDublicates();
+    }
+
+    std::vector<std::string_view> result_intersection(GetWordFrequencies(document_id).size());
     std::copy_if(std::execution::par,
                  prepared_query.plus_words.begin(), prepared_query.plus_words.end(),
                  result_intersection.begin(),
@@ -147,38 +460,133 @@ Matching SearchServer::MatchDocument(std::execution::parallel_policy, std::strin
     // найдем первое не пустое слово
     auto start = std::upper_bound(result_intersection.begin(), result_intersection.end(), ""sv);
 
-    return {{start, result_intersection.end()}, document_info_.at(document_id).status};
+    return {{start, result_intersection.end()}, status};
+}
+
+SearchServer::PreparedQuery SearchServer::PrepareQuery(std::string_view raw_query) const {
+    PreparedQuery query(raw_query);
+    query.words_ = ParseQuery(*query.raw_query_);
+    query.epoch_ = index_epoch_;
+    return query;
+}
+
+void SearchServer::RefreshQuery(PreparedQuery& query) const {
+    if (query.epoch_ != index_epoch_) {
+        query.words_ = ParseQuery(*query.raw_query_);
+        query.epoch_ = index_epoch_;
+    }
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus given_status /* = DocumentStatus::ACTUAL */,
+                                                     QueryStats* stats /* = nullptr */) const {
+    return FindTopDocuments(query, StatusIn({given_status}), stats);
+}
+
+Matching SearchServer::MatchDocument(const PreparedQuery& query, int document_id, QueryStats* stats /* = nullptr */) const {
+    TRACE_SPAN(TraceSpan::MATCH_DOCUMENT);
+
+    if (stats != nullptr) {
+        *stats = {};
+    }
+    PhaseTimer total_timer(stats != nullptr ? &stats->total_ns : nullptr);
+
+    if (IsNegativeDocumentId(document_id)) {
+        throw std::invalid_argument("Negative document id"s);
+    }
+
+    if (IsNonExistentDocumentId(document_id)) {
+        throw std::invalid_argument("Nonexistent document id"s);
+    }
+
+    // MatchParsedQuery дописывает в слова раскрытые шаблоны -- работаем с копией в арене
+    ScratchArena::Scope scratch;
+    PlusMinusWords query_words(scratch.GetResource());
+    {
+        PhaseTimer parse_timer(stats != nullptr ? &stats->parse_ns : nullptr);
+        if (query.epoch_ == index_epoch_) {
+            query_words = query.words_;
+        } else {
+            query_words = ParseQuery(*query.raw_query_, false, scratch.GetResource());
+        }
+    }
+
+    return MatchParsedQuery(query_words, document_id, stats);
 }
 
 int SearchServer::GetDocumentCount() const {
-    return document_order_.size();
+    return internal_ids_.Size();
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if (TF_by_id_.count(document_id)) {
-        return TF_by_id_.at(document_id);
+uint64_t SearchServer::EstimateQueryCost(std::string_view raw_query) const {
+    ScratchArena::Scope scratch;
+    const PlusMinusWords query_words = ParseQuery(raw_query, false, scratch.GetResource());
+
+    uint64_t cost = 0;
+    auto add_postings = [this, &cost](std::string_view word) {
+        if (const TermPostings* postings = TF_by_term_.Find(word)) {
+            cost += postings->size();
+        }
+    };
+
+    for (const std::pmr::vector<const TermPostings*>* postings : {&query_words.plus_postings, &query_words.minus_postings, &query_words.synonym_postings}) {
+        for (const TermPostings* word_postings : *postings) {
+            cost += word_postings != nullptr ? word_postings->size() : 0;
+        }
+    }
+    for (std::string_view pattern : query_words.plus_patterns) {
+        for (std::string_view word : ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS)) {
+            add_postings(word);
+        }
     }
-    static const std::map<std::string_view, double> empty_map{};
+    for (std::string_view pattern : query_words.minus_patterns) {
+        for (std::string_view word : ExpandPattern(pattern, TF_by_term_.Size())) {
+            add_postings(word);
+        }
+    }
+    // раскрывать слово с опечаткой ради оценки слишком дорого -- берем верхнюю границу
+    cost += query_words.fuzzy_words.size() * internal_ids_.Size();
+
+    return cost;
+}
+
+const WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const {
+    if (const int internal_id = internal_ids_.Find(document_id); internal_id != DocumentIdMap::NOT_FOUND) {
+        return document_words_[internal_id];
+    }
+    static const WordFrequencies empty_map{};
     return empty_map;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (document_order_.count(document_id) == 0) {
+    const int internal_id = internal_ids_.Find(document_id);
+    if (internal_id == DocumentIdMap::NOT_FOUND) {
         return;
     }
 
-    for (const auto& [word, freq] : TF_by_id_.at(document_id)) {
-        TF_by_term_.at(word).erase(document_id);
-        
-        if (TF_by_term_.at(word).empty()) {
-            TF_by_term_.erase(word);
+    WordFrequencies& frequencies = document_words_[internal_id];
+
+    if (positional_index_) {
+        std::vector<std::string_view> words;
+        for (const auto& [word, freq] : frequencies) {
+            words.push_back(word);
         }
+        positional_index_->RemoveDocument(internal_id, words);
     }
 
-    TF_by_id_.erase(document_id);
-    document_info_.erase(document_id);
-    document_order_.erase(document_id);
+    size_t removed_term_count = 0;
+    for (const auto& [word, freq] : frequencies) {
+        TermPostings& postings = *TF_by_term_.Find(word);
+        postings.erase(internal_id);
+
+        if (postings.empty()) {
+            TF_by_term_.Erase(word);
+            ++removed_term_count;
+        }
+    }
+    UpdateTermDictionary({}, removed_term_count);
 
+    frequencies.clear();
+    ForgetDocument(document_id);
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document_id) {
@@ -186,53 +594,344 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document
 }
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy, int document_id) {
-    if (document_order_.count(document_id) == 0) {
+    const int internal_id = internal_ids_.Find(document_id);
+    if (internal_id == DocumentIdMap::NOT_FOUND) {
         return;
     }
 
-   std::vector<std::string_view> words(TF_by_id_.at(document_id).size());
+    WordFrequencies& frequencies = document_words_[internal_id];
+   std::vector<std::string_view> words(frequencies.size());
 
-    std::transform(std::execution::par, TF_by_id_.at(document_id).begin(), TF_by_id_.at(document_id).end(),
+    std::transform(std::execution::par, frequencies.begin(), frequencies.end(),
                    words.begin(),
                    [](auto& item) { return item.first; });
 
      std::for_each(std::execution::par, words.begin(), words.end(),
-                  [this, document_id](std::string_view word) { (this->TF_by_term_).at(word).erase(document_id); });
+                  [this, internal_id](std::string_view word) { this->TF_by_term_.Find(word)->erase(internal_id); });
+
+    if (positional_index_) {
+        positional_index_->RemoveDocument(internal_id, words);
+    }
 
     /* это медленно ровно как непараллельная версия, потому что по map параллельные алгоритмы почему-то плохо работают
        поэтому мы выше и делаем вектор (но не строк, а указателей, чтобы не таскать эти строки!)
     
-    std::for_each(std::execution::par, TF_by_id_.at(document_id).begin(), TF_by_id_.at(document_id).end(),
+    std::for_each(std::execution::par, frequencies.begin(), frequencies.end(),
                   [this, document_id](const auto item) { (this->TF_by_term_).at(item.first).erase(document_id); }); */
 
-    TF_by_id_.erase(document_id);
-    document_info_.erase(document_id);
-    document_order_.erase(document_id);
+    frequencies.clear();
+    ForgetDocument(document_id);
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        const int internal_id = internal_ids_.Find(document_id);
+        if (internal_id != DocumentIdMap::NOT_FOUND) {
+            TombstoneDocument(document_id, internal_id);
+        }
+    }
+
+    if (!unpurged_documents_.empty() && unpurged_documents_.size() * 4 >= internal_ids_.Size()) {
+        PurgeRemovedDocuments();
+    }
+}
+
+void SearchServer::TombstoneDocument(int document_id, int internal_id) {
+    WordFrequencies& frequencies = document_words_[internal_id];
+    for (const auto& [word, _] : frequencies) {
+        removed_postings_.emplace_back(word, internal_id);
+    }
+    frequencies.clear();
+    ForgetDocument(document_id);
+    unpurged_documents_.push_back(internal_id);
+}
+
+void SearchServer::PurgeRemovedDocuments() {
+    if (unpurged_documents_.empty()) {
+        return;
+    }
+
+    // группируем по постингам слова (сравниваются указатели, а не строки), внутри слова -- по id:
+    // постинги каждого слова чистит ровно один поток, и вычеркиваемые id идут подряд
+    struct RemovedPosting {
+        TermPostings* postings;
+        int internal_id;
+        std::string_view word;
+
+        bool operator<(const RemovedPosting& other) const {
+            return std::tie(postings, internal_id) < std::tie(other.postings, other.internal_id);
+        }
+    };
+
+    std::vector<RemovedPosting> removed;
+    removed.reserve(removed_postings_.size());
+    for (const auto& [word, internal_id] : removed_postings_) {
+        removed.push_back({TF_by_term_.Find(word), internal_id, word});
+    }
+    std::sort(std::execution::par, removed.begin(), removed.end());
+
+    std::vector<size_t> term_starts;
+    for (size_t i = 0; i < removed.size(); ++i) {
+        if (i == 0 || removed[i].postings != removed[i - 1].postings) {
+            term_starts.push_back(i);
+        }
+    }
+    const size_t term_count = term_starts.size();
+    term_starts.push_back(removed.size());
+
+    std::vector<size_t> terms(term_count);
+    std::iota(terms.begin(), terms.end(), 0);
+    std::for_each(std::execution::par, terms.begin(), terms.end(), [&removed, &term_starts](size_t term) {
+        const size_t begin = term_starts[term];
+        const size_t end = term_starts[term + 1];
+        TermPostings& postings = *removed[begin].postings;
+
+        if ((end - begin) * 8 < postings.size()) {
+            for (size_t i = begin; i < end; ++i) {
+                postings.erase(removed[i].internal_id);
+            }
+            return;
+        }
+
+        // вычеркивается заметная доля постингов -- один проход слиянием дешевле поиска каждого id в дереве
+        auto posting = postings.begin();
+        for (size_t i = begin; i < end && posting != postings.end();) {
+            if (posting->first < removed[i].internal_id) {
+                ++posting;
+            } else if (posting->first == removed[i].internal_id) {
+                posting = postings.erase(posting);
+                ++i;
+            } else {
+                ++i;
+            }
+        }
+    });
+
+    // опустевшие слова убираем последовательно: удаление сдвигает слоты хеш-таблицы и указатели на постинги
+    size_t removed_term_count = 0;
+    for (size_t term = 0; term < term_count; ++term) {
+        const std::string_view word = removed[term_starts[term]].word;
+        if (TF_by_term_.Find(word)->empty()) {
+            TF_by_term_.Erase(word);
+            ++removed_term_count;
+        }
+    }
+    UpdateTermDictionary({}, removed_term_count);
+
+    if (positional_index_) {
+        for (size_t i = 0; i < removed.size(); ++i) {
+            removed_postings_[i] = {removed[i].word, removed[i].internal_id};
+        }
+        positional_index_->RemoveDocuments(removed_postings_);
+    }
+
+    removed_postings_.clear();
+    removed_postings_.shrink_to_fit();
+    unpurged_documents_.clear();
+    unpurged_documents_.shrink_to_fit();
+    index_epoch_ = NextIndexEpoch();
+}
+
+int SearchServer::GetUnpurgedDocumentCount() const {
+    return static_cast<int>(unpurged_documents_.size());
+}
+
+size_t SearchServer::GetIdfDocumentCount() const {
+    return internal_ids_.Size() + unpurged_documents_.size();
+}
+
+void SearchServer::ForgetDocument(int document_id) {
+    // строка в колонках остается, но документ больше не входит ни в один битмап статуса и в среднюю длину
+    const int internal_id = GetInternalId(document_id);
+    status_bitmaps_[static_cast<int>(statuses_[internal_id])].Reset(internal_id);
+    --status_counts_[static_cast<int>(statuses_[internal_id])];
+    total_document_length_ -= document_lengths_[internal_id];
+    length_norms_.reset();
+
+    internal_ids_.Erase(document_id);
+    index_epoch_ = NextIndexEpoch();
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.documents_text = text_memory_->Get();
+    usage.term_index = term_index_memory_->Get();
+    usage.document_index = document_index_memory_->Get();
+    usage.document_ids = document_ids_memory_->Get();
+    usage.positional_index = positional_index_memory_->Get();
+
+    usage.columns = external_ids_.capacity() * sizeof(int) + ratings_.capacity() * sizeof(int)
+                    + statuses_.capacity() * sizeof(DocumentStatus) + document_lengths_.capacity() * sizeof(int)
+                    + document_texts_.capacity() * sizeof(std::string_view);
+    for (const Bitmap& status_bitmap : status_bitmaps_) {
+        usage.columns += status_bitmap.MemoryUsage();
+    }
+
+    if (const auto term_dictionary = std::atomic_load(&term_dictionary_)) {
+        usage.caches += term_dictionary->MemoryUsage();
+    }
+    if (const auto length_norms = std::atomic_load(&length_norms_)) {
+        usage.caches += length_norms->capacity() * sizeof(double);
+    }
+
+    usage.total = usage.documents_text + usage.term_index + usage.document_index + usage.document_ids
+                  + usage.columns + usage.positional_index + usage.caches;
+    return usage;
+}
+
+void SearchServer::SetMemoryBudget(size_t bytes, MemoryBudgetPolicy policy /* = MemoryBudgetPolicy::REJECT */) {
+    memory_budget_ = bytes;
+    memory_budget_policy_ = policy;
+}
+
+size_t SearchServer::GetMemoryBudget() const {
+    return memory_budget_;
+}
+
+void SearchServer::Compact() {
+    struct LiveDocument {
+        int document_id;
+        std::string text;
+        DocumentStatus status;
+        int rating;
+    };
+
+    // в порядке добавления, как при копировании
+    std::vector<LiveDocument> documents;
+    documents.reserve(internal_ids_.Size());
+    for (int internal_id = 0; internal_id < static_cast<int>(external_ids_.size()); ++internal_id) {
+        if (IsLiveDocument(internal_id)) {
+            documents.push_back({external_ids_[internal_id], std::string(document_texts_[internal_id]),
+                                 statuses_[internal_id], ratings_[internal_id]});
+        }
+    }
+
+    // ключи индексов смотрят в тексты -- индексы очищаются раньше хранилища
+    TF_by_term_.Clear();
+    // колонка частот выделена в пуле -- ее буфер отдается до release, а не только узлы
+    decltype(document_words_)(document_words_.get_allocator()).swap(document_words_);
+    removed_postings_.clear();
+    removed_postings_.shrink_to_fit();
+    unpurged_documents_.clear();
+    unpurged_documents_.shrink_to_fit();
+    if (positional_index_) {
+        positional_index_.emplace(positional_index_memory_, node_pool_.get());
+    }
+    all_data_.clear();
+    all_data_.shrink_to_fit();
+    internal_ids_.Clear();
+    std::atomic_store(&document_order_, std::shared_ptr<const DocumentOrder>());
+    // все деревья пусты -- пул отдает накопленные блоки обратно в memory_resource_
+    node_pool_->release();
+    index_epoch_ = NextIndexEpoch();
+
+    for (std::pmr::vector<int>* column : {&external_ids_, &ratings_, &document_lengths_}) {
+        column->clear();
+        column->shrink_to_fit();
+        column->reserve(documents.size());
+    }
+    statuses_.clear();
+    statuses_.shrink_to_fit();
+    statuses_.reserve(documents.size());
+    document_texts_.clear();
+    document_texts_.shrink_to_fit();
+    document_texts_.reserve(documents.size());
+    for (Bitmap& status_bitmap : status_bitmaps_) {
+        status_bitmap.Clear();
+    }
+    status_counts_.fill(0);
+    total_document_length_ = 0;
+    term_dictionary_.reset();
+    length_norms_.reset();
+
+    for (const LiveDocument& document : documents) {
+        IndexDocument(document.document_id, document.text, document.status, document.rating);
+    }
+}
+
+void SearchServer::CheckMemoryBudget(size_t document_size) {
+    if (memory_budget_ == 0) {
+        return;
+    }
+
+    // нижняя оценка роста: текст документа и его строка в колонках
+    const size_t growth = document_size + 3 * sizeof(int) + sizeof(DocumentStatus) + sizeof(std::string_view) + sizeof(WordFrequencies);
+    if (GetMemoryUsage().total + growth <= memory_budget_) {
+        return;
+    }
+
+    // уплотнять имеет смысл, только если есть строки удаленных документов
+    if (memory_budget_policy_ == MemoryBudgetPolicy::COMPACT && external_ids_.size() != internal_ids_.Size()) {
+        Compact();
+        if (GetMemoryUsage().total + growth <= memory_budget_) {
+            return;
+        }
+    }
+
+    throw std::invalid_argument("Memory budget exceeded"s);
+}
+
+void SearchServer::CountResolvedWords(const PlusMinusWords& query_words, QueryStats* stats) const {
+    if (stats == nullptr) {
+        return;
+    }
+
+    stats->plus_words = query_words.plus_words.size();
+    stats->minus_words = query_words.minus_words.size();
+    stats->plus_words_resolved = std::count_if(query_words.plus_words.begin(), query_words.plus_words.end(),
+                                               [this](std::string_view word) { return TF_by_term_.Find(word) != nullptr; });
+    stats->minus_words_resolved = std::count_if(query_words.minus_words.begin(), query_words.minus_words.end(),
+                                                [this](std::string_view word) { return TF_by_term_.Find(word) != nullptr; });
+
+    // шаблон считается одним словом, найденным, если под него подходит хоть одно слово словаря
+    auto is_pattern_resolved = [this](std::string_view pattern) { return !ExpandPattern(pattern, 1).empty(); };
+    stats->plus_words += query_words.plus_patterns.size();
+    stats->minus_words += query_words.minus_patterns.size();
+    stats->plus_words_resolved += std::count_if(query_words.plus_patterns.begin(), query_words.plus_patterns.end(), is_pattern_resolved);
+    stats->minus_words_resolved += std::count_if(query_words.minus_patterns.begin(), query_words.minus_patterns.end(), is_pattern_resolved);
+
+    // слово с опечаткой в индексе не найдено, даже если у него нашлись близкие слова
+    stats->plus_words += query_words.fuzzy_words.size();
 }
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStopView(std::string_view text) const {
     std::vector<std::string_view> words;
-    for (std::string_view word : SplitIntoWordsView(text)) {
+    ForEachWord(text, [this, &words](std::string_view word) {
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
-    }
+    });
 
     return words;
 }
 
-SearchServer::PlusMinusWords SearchServer::ParseQuery(std::string_view raw_query, bool is_parallel_need) const {
+std::pmr::vector<std::string_view> SearchServer::SplitIntoWordsNoStopView(std::string_view text, std::pmr::memory_resource* resource) const {
+    std::pmr::vector<std::string_view> words(resource);
+    ForEachWord(text, [this, &words](std::string_view word) {
+        if (!IsStopWord(word)) {
+            words.push_back(word);
+        }
+    });
+
+    return words;
+}
+
+SearchServer::PlusMinusWords SearchServer::ParseQuery(std::string_view raw_query, bool is_parallel_need,
+                                                     std::pmr::memory_resource* resource /* = std::pmr::get_default_resource() */) const {
+    TRACE_SPAN(TraceSpan::PARSE);
 
-    SearchServer::PlusMinusWords query_words;
+    SearchServer::PlusMinusWords query_words(resource);
 
     ThrowSpecialSymbolInText(raw_query);
 
     // это нужно, чтобы и плюс-, и минус-слова в своих векторах были уже отсортированы, потому что далее их ждет unique-erase
-    std::vector<std::string_view> splited_query = SplitIntoWordsNoStopView(raw_query);
+    std::pmr::vector<std::string_view> splited_query = raw_query.find('"') == std::string_view::npos
+                                                       ? SplitIntoWordsNoStopView(raw_query, resource)
+                                                       : ParsePhrases(raw_query, query_words.phrases, resource);
 
     for (std::string_view word : splited_query) {
         if (word[0] == '-') {
@@ -242,18 +941,48 @@ SearchServer::PlusMinusWords SearchServer::ParseQuery(std::string_view raw_query
                 throw std::invalid_argument("Alone or double minus in query"s);
             }
 
-            query_words.minus_words.push_back(minus_word);
+            if (minus_word.find('*') != std::string_view::npos) {
+                ThrowWildcardWithoutPrefix(minus_word);
+                query_words.minus_patterns.push_back(minus_word);
+            } else {
+                query_words.minus_words.push_back(minus_word);
+            }
 
+        } else if (word.find('*') != std::string_view::npos) {
+            ThrowWildcardWithoutPrefix(word);
+            query_words.plus_patterns.push_back(word);
         } else {
             query_words.plus_words.push_back(word);
         }
     }
 
+    // неизвестные индексу слова уходят в нечеткий поиск; известные ищутся как есть
+    if (fuzzy_distance_ > 0) {
+        auto unknown_begin = std::stable_partition(query_words.plus_words.begin(), query_words.plus_words.end(),
+                                                   [this](std::string_view word) { return TF_by_term_.Find(word) != nullptr; });
+        query_words.fuzzy_words.assign(unknown_begin, query_words.plus_words.end());
+        query_words.plus_words.erase(unknown_begin, query_words.plus_words.end());
+    }
+
+    // шаблонов и слов с опечатками в запросе единицы -- чистим от повторов в обеих версиях, чтобы они не ранжировались дважды
+    for (std::pmr::vector<std::string_view>* patterns : {&query_words.plus_patterns, &query_words.minus_patterns, &query_words.fuzzy_words}) {
+        std::sort(patterns->begin(), patterns->end());
+        patterns->erase(std::unique(patterns->begin(), patterns->end()), patterns->end());
+    }
+
+    for (const Phrase& phrase : query_words.phrases) {
+        query_words.plus_words.insert(query_words.plus_words.end(), phrase.words.begin(), phrase.words.end());
+    }
+
+    if (synonyms_.GetWordCount() > 0) {
+        AddSynonymWords(query_words);
+    }
+
     if (is_parallel_need) {
         return query_words;
     }
 
-    std::vector<std::string_view>::iterator last;
+    std::pmr::vector<std::string_view>::iterator last;
 
     std::sort(std::execution::par,
               query_words.plus_words.begin(), query_words.plus_words.end());
@@ -267,9 +996,295 @@ SearchServer::PlusMinusWords SearchServer::ParseQuery(std::string_view raw_query
     last = std::unique(query_words.minus_words.begin(), query_words.minus_words.end());
     query_words.minus_words.erase(last, query_words.minus_words.end());
 
+    ResolvePostings(query_words);
+
     return query_words;
 }
 
+void SearchServer::ResolvePostings(PlusMinusWords& query_words) const {
+    auto resolve = [this](const std::pmr::vector<std::string_view>& words, std::pmr::vector<const TermPostings*>& postings) {
+        postings.clear();
+        postings.reserve(words.size());
+        for (std::string_view word : words) {
+            postings.push_back(TF_by_term_.Find(word));
+        }
+    };
+
+    resolve(query_words.plus_words, query_words.plus_postings);
+    resolve(query_words.synonym_words, query_words.synonym_postings);
+    resolve(query_words.minus_words, query_words.minus_postings);
+}
+
+uint64_t SearchServer::NextIndexEpoch() {
+    return next_index_epoch.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SearchServer::AddSynonymWords(PlusMinusWords& query_words) const {
+    for (std::string_view word : query_words.plus_words) {
+        synonyms_.ForEachSynonym(word, [this, &query_words](std::string_view synonym) {
+            if (TF_by_term_.Find(synonym) != nullptr) {
+                query_words.synonym_words.push_back(synonym);
+            }
+        });
+    }
+
+    // синоним, который и так есть в запросе, уже ранжируется с полным весом
+    auto is_plus_word = [&query_words](std::string_view synonym) {
+        return std::find(query_words.plus_words.begin(), query_words.plus_words.end(), synonym) != query_words.plus_words.end();
+    };
+    std::pmr::vector<std::string_view>& synonym_words = query_words.synonym_words;
+    std::sort(synonym_words.begin(), synonym_words.end());
+    synonym_words.erase(std::unique(synonym_words.begin(), synonym_words.end()), synonym_words.end());
+    synonym_words.erase(std::remove_if(synonym_words.begin(), synonym_words.end(), is_plus_word), synonym_words.end());
+}
+
+std::pmr::vector<std::string_view> SearchServer::ParsePhrases(std::string_view raw_query, std::vector<Phrase>& phrases, std::pmr::memory_resource* resource) const {
+    if (!positional_index_) {
+        throw std::invalid_argument("Phrase query without positional index"s);
+    }
+
+    std::pmr::vector<std::string_view> words(resource);
+
+    while (!raw_query.empty()) {
+        const size_t open_quote = raw_query.find('"');
+        for (std::string_view word : SplitIntoWordsNoStopView(raw_query.substr(0, open_quote), resource)) {
+            words.push_back(word);
+        }
+
+        if (open_quote == std::string_view::npos) {
+            break;
+        }
+
+        if (open_quote > 0 && raw_query[open_quote - 1] == '-') {
+            throw std::invalid_argument("Minus phrase in query"s);
+        }
+
+        const size_t close_quote = raw_query.find('"', open_quote + 1);
+        if (close_quote == std::string_view::npos) {
+            throw std::invalid_argument("Unclosed quote in query"s);
+        }
+
+        Phrase phrase;
+        phrase.words = SplitIntoWordsNoStopView(raw_query.substr(open_quote + 1, close_quote - open_quote - 1));
+        if (phrase.words.empty()) {
+            throw std::invalid_argument("Empty phrase in query"s);
+        }
+
+        raw_query.remove_prefix(close_quote + 1);
+
+        // "..."~N -- между словами фразы может оказаться до N других слов
+        if (!raw_query.empty() && raw_query[0] == '~') {
+            const char* slop_begin = raw_query.data() + 1;
+            const char* slop_end = raw_query.data() + raw_query.size();
+            const auto [parsed_end, error] = std::from_chars(slop_begin, slop_end, phrase.slop);
+            // за числом -- пробел или конец запроса: "a b"~1c не читается как ~1 и слово c
+            if (error != std::errc() || phrase.slop < 0 || (parsed_end != slop_end && *parsed_end != ' ')) {
+                throw std::invalid_argument("Invalid phrase slop in query"s);
+            }
+            raw_query.remove_prefix(parsed_end - raw_query.data());
+        }
+
+        phrases.push_back(std::move(phrase));
+    }
+
+    return words;
+}
+
+std::vector<std::string_view> SearchServer::ExpandPattern(std::string_view pattern, size_t max_terms) const {
+    const std::string_view prefix = pattern.substr(0, pattern.find('*'));
+    const bool is_prefix_pattern = prefix.size() + 1 == pattern.size(); // serv* -- под шаблон подходит весь диапазон
+
+    const std::shared_ptr<const TermDictionary> dictionary = GetTermDictionary();
+    const bool has_removed_terms = dictionary->HasRemovedTerms();
+    return dictionary->FindPrefix(prefix, max_terms, [&](std::string_view term) {
+        return (is_prefix_pattern || IsWildcardMatch(term, pattern)) && (!has_removed_terms || TF_by_term_.Find(term) != nullptr);
+    });
+}
+
+std::vector<std::pair<int, double>> SearchServer::MergePostings(const std::vector<std::string_view>& terms, uint64_t& postings_scanned) const {
+    std::vector<std::pair<int, double>> merged;
+    for (std::string_view term : terms) {
+        const TermPostings& postings = *TF_by_term_.Find(term);
+        merged.insert(merged.end(), postings.begin(), postings.end());
+    }
+    postings_scanned += merged.size();
+
+    if (terms.size() < 2) {
+        return merged;
+    }
+
+    // постинги каждого слова уже отсортированы по id: после общей сортировки складываем TF соседних одинаковых id
+    std::sort(merged.begin(), merged.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+    auto last = merged.begin();
+    for (auto it = std::next(merged.begin()); it != merged.end(); ++it) {
+        if (it->first == last->first) {
+            last->second += it->second;
+        } else {
+            *++last = *it;
+        }
+    }
+    merged.erase(std::next(last), merged.end());
+
+    return merged;
+}
+
+std::vector<std::string_view> SearchServer::ExpandFuzzyWord(std::string_view word) const {
+    const int max_distance = GetFuzzyDistanceForWord(word, fuzzy_distance_);
+    if (max_distance == 0) {
+        return {};
+    }
+
+    // берем только ближайшие слова: если нашлись слова на расстоянии 1, дальние не ищем. Так запрос не размывается
+    // словами на расстоянии 2, которых в большом словаре много, а поиск по расстоянию 1 еще и дешевле
+    const std::shared_ptr<const TermDictionary> dictionary = GetTermDictionary();
+    std::vector<std::pair<int, std::string_view>> matches;
+    for (int distance = 1; distance <= max_distance && matches.empty(); ++distance) {
+        matches = dictionary->FindFuzzy(LevenshteinAutomaton(word, distance));
+        // пропавшие слова еще лежат в снимке
+        if (dictionary->HasRemovedTerms()) {
+            matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                         [this](const auto& match) { return TF_by_term_.Find(match.second) == nullptr; }),
+                          matches.end());
+        }
+    }
+
+    // ближайшие слова вперед, при равном расстоянии -- в порядке словаря
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    if (matches.size() > MAX_PATTERN_EXPANSIONS) {
+        matches.resize(MAX_PATTERN_EXPANSIONS);
+    }
+
+    std::vector<std::string_view> terms;
+    for (const auto& [distance, term] : matches) {
+        terms.push_back(term);
+    }
+
+    return terms;
+}
+
+std::shared_ptr<const TermDictionary> SearchServer::GetTermDictionary() const {
+    // запросы идут параллельно, поэтому снимок словаря читаем и публикуем атомарно;
+    // если его одновременно построят два запроса, они построят одно и то же
+    std::shared_ptr<const TermDictionary> dictionary = std::atomic_load(&term_dictionary_);
+    if (dictionary) {
+        return dictionary;
+    }
+
+    std::vector<std::string_view> terms;
+    terms.reserve(TF_by_term_.Size());
+    TF_by_term_.ForEach([&terms](std::string_view term, const TermPostings&) { terms.push_back(term); });
+    // хеш-таблица порядка не хранит -- сортируем один раз на снимок
+    std::sort(terms.begin(), terms.end());
+
+    dictionary = std::make_shared<const TermDictionary>(std::move(terms));
+    std::atomic_store(&term_dictionary_, dictionary);
+    return dictionary;
+}
+
+void SearchServer::UpdateTermDictionary(std::vector<std::string_view> added_terms, size_t removed_term_count) {
+    // снимка нет -- его целиком построит первый запрос, которому он понадобится
+    if (!term_dictionary_ || (added_terms.empty() && removed_term_count == 0)) {
+        return;
+    }
+    term_dictionary_ = term_dictionary_->Update(std::move(added_terms), removed_term_count,
+                                                [this](std::string_view term) { return TF_by_term_.Find(term) != nullptr; });
+}
+
+std::shared_ptr<const SearchServer::DocumentOrder> SearchServer::GetDocumentOrder() const {
+    std::shared_ptr<const DocumentOrder> order = std::atomic_load(&document_order_);
+    if (order && order->epoch == index_epoch_) {
+        return order;
+    }
+
+    auto fresh_order = std::make_shared<DocumentOrder>(
+        DocumentOrder{index_epoch_, DocumentIds(CountingAllocator<int>(document_ids_memory_, memory_resource_))});
+    fresh_order->ids.reserve(internal_ids_.Size());
+    for (int internal_id = 0; internal_id < static_cast<int>(external_ids_.size()); ++internal_id) {
+        if (IsLiveDocument(internal_id)) {
+            fresh_order->ids.push_back(external_ids_[internal_id]);
+        }
+    }
+    std::sort(fresh_order->ids.begin(), fresh_order->ids.end());
+
+    // begin() и end() из разных потоков должны получить один снимок: если его уже опубликовал другой поток,
+    // берем опубликованный. Старый снимок живет до замены, так что обход, внутри которого удаляются
+    // документы, не теряет свой вектор
+    std::shared_ptr<const DocumentOrder> published = fresh_order;
+    if (std::atomic_compare_exchange_strong(&document_order_, &order, published)) {
+        return published;
+    }
+    return order;
+}
+
+std::shared_ptr<const std::vector<double>> SearchServer::GetLengthNorms() const {
+    std::shared_ptr<const std::vector<double>> length_norms = std::atomic_load(&length_norms_);
+    if (length_norms) {
+        return length_norms;
+    }
+
+    const double average_length = internal_ids_.Size() == 0 ? 0.0 : static_cast<double>(total_document_length_) / internal_ids_.Size();
+    const double k1 = bm25_params_.k1;
+    const double b = bm25_params_.b;
+
+    // документ без слов (одни стоп-слова) в постинги не попадает, его норма не читается
+    std::vector<double> norms(document_lengths_.size());
+    for (size_t internal_id = 0; internal_id < norms.size(); ++internal_id) {
+        const int length = document_lengths_[internal_id];
+        if (length > 0) {
+            norms[internal_id] = k1 * (1 - b + b * length / average_length) / length;
+        }
+    }
+
+    length_norms = std::make_shared<const std::vector<double>>(std::move(norms));
+    std::atomic_store(&length_norms_, length_norms);
+    return length_norms;
+}
+
+void SearchServer::ExpandQueryToWords(PlusMinusWords& query_words) const {
+    for (std::string_view pattern : query_words.plus_patterns) {
+        for (std::string_view word : ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS)) {
+            query_words.plus_words.push_back(word);
+        }
+    }
+    for (std::string_view fuzzy_word : query_words.fuzzy_words) {
+        for (std::string_view word : ExpandFuzzyWord(fuzzy_word)) {
+            query_words.plus_words.push_back(word);
+        }
+    }
+    for (std::string_view pattern : query_words.minus_patterns) {
+        for (std::string_view word : ExpandPattern(pattern, TF_by_term_.Size())) {
+            query_words.minus_words.push_back(word);
+        }
+    }
+    query_words.plus_words.insert(query_words.plus_words.end(), query_words.synonym_words.begin(), query_words.synonym_words.end());
+
+    query_words.plus_patterns.clear();
+    query_words.minus_patterns.clear();
+    query_words.fuzzy_words.clear();
+    query_words.synonym_words.clear();
+}
+
+std::optional<std::vector<int>> SearchServer::FindPhraseMatches(const PlusMinusWords& query_words) const {
+    if (query_words.phrases.empty()) {
+        return std::nullopt;
+    }
+
+    std::vector<int> matches = positional_index_->FindPhrase(query_words.phrases[0]);
+    for (size_t i = 1; i < query_words.phrases.size() && !matches.empty(); ++i) {
+        const std::vector<int> phrase_matches = positional_index_->FindPhrase(query_words.phrases[i]);
+
+        std::vector<int> intersection;
+        std::set_intersection(matches.begin(), matches.end(), phrase_matches.begin(), phrase_matches.end(),
+                              std::back_inserter(intersection));
+        matches = std::move(intersection);
+    }
+
+    return matches;
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
 
     if (ratings.size() > 0) {
@@ -288,7 +1303,7 @@ bool SearchServer::IsNegativeDocumentId(const int document_id) const {
 }
 
 bool SearchServer::IsRecurringDocumentId(const int document_id) const {
-    return document_info_.count(document_id);
+    return internal_ids_.Find(document_id) != DocumentIdMap::NOT_FOUND;
 }
 
 void SearchServer::ThrowSpecialSymbolInText(std::string_view text) const {
@@ -297,8 +1312,26 @@ void SearchServer::ThrowSpecialSymbolInText(std::string_view text) const {
     }
 }
 
+void SearchServer::ThrowWildcardWithoutPrefix(std::string_view pattern) const {
+    if (pattern[0] == '*') { // такой шаблон раскрывался бы перебором всего словаря
+        throw std::invalid_argument("Wildcard without prefix in query"s);
+    }
+}
+
 bool SearchServer::IsNonExistentDocumentId(const int document_id) const {
-    return !document_order_.count(document_id);
+    return internal_ids_.Find(document_id) == DocumentIdMap::NOT_FOUND;
+}
+
+int SearchServer::GetInternalId(int document_id) const {
+    const int internal_id = internal_ids_.Find(document_id);
+    if (internal_id == DocumentIdMap::NOT_FOUND) {
+        throw std::out_of_range("Nonexistent document id"s);
+    }
+    return internal_id;
+}
+
+bool SearchServer::IsLiveDocument(int internal_id) const {
+    return internal_ids_.Find(external_ids_[internal_id]) == internal_id;
 }
 
 void AddDocument(SearchServer& search_server, int document_id, std::string_view document, const DocumentStatus& status, const std::vector<int>& ratings) {
@@ -7,63 +7,187 @@
 #include <deque>
 #include <tuple>
 #include <map>
+#include <optional>
 #include <cmath>
 #include <algorithm>
 #include <numeric>
 #include <execution>
+#include <array>
+#include <type_traits>
+#include <memory>
+#include <memory_resource>
+#include <future>
+#include "bitmap.h"
 #include "document.h"
+#include "document_id_map.h"
+#include "document_filter.h"
+#include "levenshtein_automaton.h"
+#include "memory_usage.h"
+#include "term_dictionary.h"
+#include "term_hash_map.h"
+#include "positional_index.h"
+#include "ranking.h"
+#include "scratch_arena.h"
+#include "stop_word_filter.h"
 #include "string_processing.h"
+#include "synonym_graph.h"
+#include "query_stats.h"
+#include "query_deadline.h"
+#include "trace.h"
 #include "concurrent_map.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const int PRECISE = 1e-06;
+const int MAX_PATTERN_EXPANSIONS = 64; // сколько слов словаря максимум учитывается при ранжировании по шаблону вида serv*
 
 using namespace std::literals;
 using Matching = std::tuple<std::vector<std::string_view>, DocumentStatus>;
+// частоты слов документа (GetWordFrequencies); память считается в MemoryUsage::document_index
+using WordFrequencies = std::map<std::string_view, double, std::less<std::string_view>,
+                                 CountingAllocator<std::pair<const std::string_view, double>>>;
+// внешние id живых документов подряд, по возрастанию
+using DocumentIds = std::vector<int, CountingAllocator<int>>;
 
 class SearchServer {
 
 public:
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    DocumentIds::const_iterator begin() const;
+    DocumentIds::const_iterator end() const;
+
+    // Во всех конструкторах resource -- откуда индекс берет память: тексты и колонки выделяются прямо в нем,
+    // узлы деревьев -- через собственный пул сервера поверх resource, так что мелкие узлы не дробят кучу.
+    // resource должен пережить сервер; с арендой (monotonic_buffer_resource) освобождение узлов ничего не стоит,
+    // и вся память индекса возвращается разом при освобождении аренды
 
     // конструктор на основе коллекции vector или set
     template<typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     // конструктор на основе строки с любым количеством пробелов до, между и после слов
-    SearchServer(const std::string& stop_words_text);
+    SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     // конструктор на основе вью с любым количеством пробелов до, между и после слов
-    SearchServer(std::string_view stop_words_text);
+    SearchServer(std::string_view stop_words_text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // глубокая копия: индекс строится заново по текстам документов, поэтому вью копии смотрят только в ее собственные
+    // строки (и память индекса выделяет поток, который копирует); настройки поиска переносятся, внутренние id уплотняются.
+    // Документы, удаленные RemoveDocuments и еще не вычищенные, переносятся такими же надгробиями: оригинал учитывает
+    // их в IDF, и копия ранжирует так же, как он
+    SearchServer(const SearchServer& other);
+
+    // глубокая копия в память resource
+    SearchServer(const SearchServer& other, std::pmr::memory_resource* resource);
+
+    // перенос строк deque не двигает, вью остаются действительными
+    SearchServer(SearchServer&& other) = default;
 
     void AddDocument(int document_id, std::string_view document, const DocumentStatus& status, const std::vector<int>& ratings);
 
+    // меняет текст документа, сохраняя его id, статус и рейтинг: новые и старые слова сравниваются по прямому индексу,
+    // и постинги меняются только у слов, которые появились, пропали или у которых изменился TF.
+    // Старый текст остается в хранилище до Compact
+    void UpdateDocument(int document_id, std::string_view document);
+
+    // меняет статус и рейтинг документа; индекс слов не трогается
+    void UpdateDocumentAttributes(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+
+    // включает индекс позиций слов (строится и по уже добавленным документам); без него фразовые
+    // запросы ("fast search server", "search server"~1 -- до одного слова между ними) бросают invalid_argument
+    void EnablePositionalIndex();
+
+    bool IsPositionalIndexEnabled() const;
+
+    // нечеткий поиск: плюс-слово, которого нет в индексе, заменяется ближайшими словами словаря на расстоянии
+    // Левенштейна до max_distance (1 или 2; слова короче 6 букв -- до 1, короче 3 -- не заменяются): если есть
+    // слова на расстоянии 1, слова на расстоянии 2 не берутся; 0 -- выключить
+    void SetFuzzyDistance(int max_distance);
+
+    int GetFuzzyDistance() const;
+
+    // расширение запроса синонимами: плюс-слова дополняются своими синонимами из графа, совпадение с синонимом
+    // дает вклад в релевантность с множителем weight из (0, 1]; пустой граф -- выключить
+    void SetSynonyms(SynonymGraph synonyms, double weight = 0.5);
+
+    const SynonymGraph& GetSynonyms() const;
+
+    // функция ранжирования: TF-IDF (по умолчанию) или BM25 с параметрами params
+    void SetRankingFunction(RankingFunction ranking_function, Bm25Params params = {});
+
+    RankingFunction GetRankingFunction() const;
+
+    // во все перегрузки FindTopDocuments и MatchDocument можно последним параметром передать QueryStats*,
+    // тогда в него запишется статистика выполнения запроса; без него статистика не собирается
+
     // перегрузка FindTopDocuments для передачи в качестве второго параметра функционального объекта
+    // или выражения DocumentFilter (StatusIn, RatingBetween, IdBetween, Where и их комбинации через &&)
     template <typename Predicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate filter) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate filter, QueryStats* stats = nullptr) const;
 
     // перегрузка FindTopDocuments для передачи политики и в качестве третьего параметра функционального объекта
     template <typename ExecutionPolicy, typename Predicate>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, Predicate filter) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, Predicate filter, QueryStats* stats = nullptr) const;
 
     // перегрузка FindTopDocuments для принятия статусов
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus given_status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus given_status = DocumentStatus::ACTUAL, QueryStats* stats = nullptr) const;
 
     // перегрузка FindTopDocuments для принятия политики и статусов
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus given_status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus given_status = DocumentStatus::ACTUAL, QueryStats* stats = nullptr) const;
+
+    // поиск со сроком и отменой (например, QueryDeadline::After(50ms, token)): срок проверяется между блоками постингов,
+    // когда он выходит, ранжирование останавливается и возвращаются лучшие из уже посчитанных документов с is_truncated
+    template <typename Predicate>
+    SearchResult FindTopDocumentsWithDeadline(std::string_view raw_query, const QueryDeadline& deadline, Predicate filter) const;
+
+    SearchResult FindTopDocumentsWithDeadline(std::string_view raw_query, const QueryDeadline& deadline, DocumentStatus given_status = DocumentStatus::ACTUAL) const;
+
+    // то же в отдельном потоке; пока результат не получен, сервер нельзя менять и разрушать.
+    // исключения (например, неверный запрос) приходят через future
+    template <typename Predicate>
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query, QueryDeadline deadline, Predicate filter) const;
+
+    std::future<SearchResult> FindTopDocumentsAsync(std::string_view raw_query, QueryDeadline deadline = {}, DocumentStatus given_status = DocumentStatus::ACTUAL) const;
+
+    // постраничная выдача "search after": page_size документов, идущих в выдаче сразу после cursor
+    // (std::nullopt -- с начала); порядок -- релевантность, рейтинг по убыванию, затем id по возрастанию
+    template <typename Predicate>
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, const std::optional<SearchCursor>& cursor, int page_size, Predicate filter) const;
+
+    SearchPage FindTopDocumentsAfter(std::string_view raw_query, const std::optional<SearchCursor>& cursor, int page_size, DocumentStatus given_status = DocumentStatus::ACTUAL) const;
 
     int GetDocumentCount() const;
 
-    Matching MatchDocument(std::string_view raw_query, int document_id) const;
+    // оценка стоимости запроса без его выполнения: сколько постингов придется пройти (плюс- и минус-слова, синонимы,
+    // раскрытые шаблоны; слово с опечаткой считается как все документы); бросает invalid_argument на неверный запрос
+    uint64_t EstimateQueryCost(std::string_view raw_query) const;
 
-    Matching MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
+    Matching MatchDocument(std::string_view raw_query, int document_id, QueryStats* stats = nullptr) const;
+
+    Matching MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id, QueryStats* stats = nullptr) const;
+
+    Matching MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id, QueryStats* stats = nullptr) const;
+
+    class PreparedQuery;
+
+    // разбирает запрос один раз для многократного выполнения: слова проверены, отсортированы, без повторов, их постинги
+    // найдены; бросает invalid_argument на неверный запрос, как FindTopDocuments
+    PreparedQuery PrepareQuery(std::string_view raw_query) const;
+
+    // разбирает запрос заново, только если индекс менялся после его подготовки (документы, синонимы, нечеткий поиск,
+    // индекс позиций) или запрос подготовлен другим сервером; иначе это одно сравнение
+    void RefreshQuery(PreparedQuery& query) const;
+
+    // FindTopDocuments и MatchDocument по подготовленному запросу. Устаревший запрос (см. RefreshQuery) выполняется
+    // верно, но разбирается при каждом вызове. Слова из Matching смотрят в строку запроса -- пока жив query
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, Predicate filter, QueryStats* stats = nullptr) const;
 
-    Matching MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus given_status = DocumentStatus::ACTUAL, QueryStats* stats = nullptr) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    Matching MatchDocument(const PreparedQuery& query, int document_id, QueryStats* stats = nullptr) const;
+
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
 
@@ -71,11 +195,71 @@ public:
 
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
 
+    // удаляет пачку документов, несуществующие id пропускаются. Документы сразу пропадают из выдачи и битмапов
+    // статусов, а их постинги остаются надгробиями и вычищаются позже одним параллельным проходом по словам
+    // (PurgeRemovedDocuments), который запускается сам, когда надгробий набирается на четверть живых документов.
+    // До чистки IDF считается так, будто удаленные документы еще в индексе: они входят и в df слова, и в число
+    // документов, поэтому IDF не бывает отрицательным, а после чистки совпадает с удалением по одному
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // вычищает из постингов документы, удаленные RemoveDocuments
+    void PurgeRemovedDocuments();
+
+    // сколько документов удалено RemoveDocuments, но еще не вычищено из постингов
+    int GetUnpurgedDocumentCount() const;
+
+    // память индекса по структурам, см. MemoryUsage
+    MemoryUsage GetMemoryUsage() const;
+
+    // бюджет памяти индекса (MemoryUsage::total) в байтах: AddDocument, который вывел бы индекс за бюджет, бросает
+    // invalid_argument, не меняя индекс, или сначала вызывает Compact -- по policy; 0 -- без бюджета.
+    // рост оценивается снизу (текст документа и его строка в колонках), поэтому бюджет может быть превышен
+    // на постинги одного документа
+    void SetMemoryBudget(size_t bytes, MemoryBudgetPolicy policy = MemoryBudgetPolicy::REJECT);
+
+    size_t GetMemoryBudget() const;
+
+    // уплотняет индекс: удаленные документы оставляют в хранилище текстов и колонках свои строки -- Compact
+    // перестраивает индекс по живым документам, освобождая их, и подрезает емкости. Внутренние id уплотняются,
+    // поэтому вью из разобранных, но не выполненных запросов и GetWordFrequencies становятся недействительными
+    void Compact();
+
 private:
 
+    using TermPostings = std::map<int, double, std::less<int>, CountingAllocator<std::pair<const int, double>>>;
+
+    // слова запроса лежат в resource; там же ScoreDocuments держит временные данные ранжирования этого запроса
     struct PlusMinusWords {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit PlusMinusWords(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : plus_words(resource)
+            , minus_words(resource)
+            , plus_patterns(resource)
+            , minus_patterns(resource)
+            , fuzzy_words(resource)
+            , synonym_words(resource)
+            , plus_postings(resource)
+            , synonym_postings(resource)
+            , minus_postings(resource) {
+        }
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::vector<Phrase> phrases; // слова фраз есть и в plus_words -- по ним считается релевантность
+        // шаблоны со '*' (serv*, s*ver*): раскрываются по словарю, у шаблона обязательно непустой префикс до первой '*'
+        std::pmr::vector<std::string_view> plus_patterns;
+        std::pmr::vector<std::string_view> minus_patterns;
+        std::pmr::vector<std::string_view> fuzzy_words; // плюс-слова, которых нет в индексе, при включенном нечетком поиске
+        // синонимы плюс-слов, которые есть в индексе, но не в самом запросе; ранжируются с весом synonym_weight_
+        std::pmr::vector<std::string_view> synonym_words;
+        // постинги plus_words, synonym_words и minus_words по тем же номерам (nullptr -- слова нет в индексе);
+        // заполняет однопоточная ParseQuery, ScoreDocuments без политики берет постинги слов только отсюда
+        std::pmr::vector<const TermPostings*> plus_postings;
+        std::pmr::vector<const TermPostings*> synonym_postings;
+        std::pmr::vector<const TermPostings*> minus_postings;
+
+        std::pmr::memory_resource* GetResource() const {
+            return plus_words.get_allocator().resource();
+        }
 
         void RemovePlusWordsDublicates() {
             std::sort(plus_words.begin(), plus_words.end());
@@ -83,32 +267,219 @@ private:
         }
     };
 
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    // ресурсы и счетчики памяти объявлены раньше контейнеров, аллокаторы которых на них смотрят.
+    // В memory_resource_ лежит все, что хранит сами документы и постинги; производные снимки (term_dictionary_,
+    // length_norms_, document_order_) и граф синонимов берут память из общей кучи: снимки строятся лениво
+    // константными методами и делятся между запросами через shared_ptr, а граф собирает вызывающий код
+    std::pmr::memory_resource* memory_resource_;
+    // пул для узлов деревьев; синхронизированный -- параллельный RemoveDocument освобождает узлы из нескольких потоков
+    std::unique_ptr<std::pmr::synchronized_pool_resource> node_pool_ = std::make_unique<std::pmr::synchronized_pool_resource>(memory_resource_);
+    std::shared_ptr<MemoryCounter> text_memory_ = std::make_shared<MemoryCounter>();
+    std::shared_ptr<MemoryCounter> term_index_memory_ = std::make_shared<MemoryCounter>();
+    std::shared_ptr<MemoryCounter> document_index_memory_ = std::make_shared<MemoryCounter>();
+    std::shared_ptr<MemoryCounter> document_ids_memory_ = std::make_shared<MemoryCounter>();
+    std::shared_ptr<MemoryCounter> positional_index_memory_ = std::make_shared<MemoryCounter>();
+    size_t memory_budget_ = 0;
+    MemoryBudgetPolicy memory_budget_policy_ = MemoryBudgetPolicy::REJECT;
+
+    // хранилище текстов, на которое смотрят вью индекса; только дописывается: старый текст обновленного
+    // документа остается здесь, пока его не освободит Compact
+    std::deque<CountedString, ScopedCountingAllocator<CountedString>> all_data_{CountingAllocator<CountedString>(text_memory_, memory_resource_)};
+    // [внешний id документа -- внутренний id, порядковый номер при добавлении]; только живые документы.
+    // Внутренние id плотные: ими индексируются колонки, битмапы и постинги; удаленный документ оставляет
+    // в колонках пустую строку, которую освобождает Compact, перенумеровывая документы подряд
+    DocumentIdMap internal_ids_{DocumentIdMap::Allocator(document_ids_memory_, memory_resource_)};
+    // колонки атрибутов документов, индексированные внутренним id
+    std::pmr::vector<int> external_ids_{memory_resource_};
+    std::pmr::vector<int> ratings_{memory_resource_};
+    std::pmr::vector<DocumentStatus> statuses_{memory_resource_};
+    std::pmr::vector<int> document_lengths_{memory_resource_}; // слов без стоп-слов
+    std::pmr::vector<std::string_view> document_texts_{memory_resource_}; // текущий текст документа в all_data_
+    // по битмапу на статус; удаленный документ не входит ни в один
+    std::array<Bitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_{Bitmap(memory_resource_), Bitmap(memory_resource_),
+                                                              Bitmap(memory_resource_), Bitmap(memory_resource_)};
+    static_assert(DOCUMENT_STATUS_COUNT == 4, "status_bitmaps_ must get memory_resource_ for every status");
+    std::array<int, DOCUMENT_STATUS_COUNT> status_counts_{}; // сколько живых документов в каждом битмапе
+    // [слово -- внутренний id] документов, удаленных RemoveDocuments, но еще не вычищенных из постингов
+    RemovedPostings removed_postings_{RemovedPostings::allocator_type(document_index_memory_, memory_resource_)};
+    // внутренние id документов, удаленных RemoveDocuments, но еще не вычищенных из постингов
+    DocumentIds unpurged_documents_{DocumentIds::allocator_type(document_index_memory_, memory_resource_)};
+    // слово -- [внутренний id -- в котором у этого слова посчитан TF_]
+    // хеш-таблица: каждое слово запроса ищется одним проходом, а порядок слов нужен только шаблонам и нечеткому поиску,
+    // и они берут его из снимка term_dictionary_
+    TermHashMap<TermPostings> TF_by_term_{TermPostings::allocator_type(term_index_memory_, node_pool_.get())};
+    // TF_ наоборот -- колонка частот слов по внутреннему id; у удаленного документа пустая
+    std::vector<WordFrequencies, ScopedCountingAllocator<WordFrequencies>> document_words_{
+        CountingAllocator<char>(document_index_memory_, node_pool_.get())};
+    const StopWordFilter stop_words_; // все стоп-слова
+    // снимок отсортированных внешних id живых документов для begin() и end(); добавление и удаление его не трогают,
+    // а только меняют index_epoch_, и снимок строится заново при следующем обходе
+    struct DocumentOrder {
+        uint64_t epoch;
+        DocumentIds ids;
     };
-
-    std::deque<std::string> all_data_; // информация о всех (+, -, и documents) словах в объекте SearchServer; хранилище, на которое смотрят вью
-    std::map<int, DocumentData> document_info_; // [id -- инфа об id (рейтинг и статус)]
-    std::map<std::string_view, std::map<int, double>> TF_by_term_; // слово -- [id -- в котором у этого слова посчитан TF_]
-    std::map<int, std::map<std::string_view, double>> TF_by_id_; // TF_ наоборот (не от слова, а от id отталкиваемся)
-    const std::set<std::string_view> stop_words_; // все стоп-слова
-    std::set<int> document_order_; // какие id вообще есть
+    mutable std::shared_ptr<const DocumentOrder> document_order_;
+    std::optional<PositionalIndex> positional_index_; // пусто -- фразовые запросы выключены
+    int fuzzy_distance_ = 0;
+    // снимок упорядоченного словаря для шаблонов и нечеткого поиска; строится первым запросом, которому нужен,
+    // а дальше следует за словами TF_by_term_ через UpdateTermDictionary, не сортируя словарь заново
+    mutable std::shared_ptr<const TermDictionary> term_dictionary_;
+    SynonymGraph synonyms_; // на него смотрят synonym_words разобранных запросов
+    double synonym_weight_ = 0.5;
+    RankingFunction ranking_function_ = RankingFunction::TF_IDF;
+    Bm25Params bm25_params_;
+    uint64_t total_document_length_ = 0; // суммарная длина живых документов -- для средней длины в BM25
+    // нормы длин документов для BM25 по внутреннему id; сбрасываются при добавлении и удалении
+    // документов (меняется средняя длина) и строятся заново первым запросом с BM25
+    mutable std::shared_ptr<const std::vector<double>> length_norms_;
+    // меняется при каждом изменении индекса, которое влияет на разбор запроса или его постинги; номера берутся
+    // из общего для всех серверов счетчика, поэтому подготовленный запрос не спутает эпохи двух серверов
+    uint64_t index_epoch_ = NextIndexEpoch();
 
 
     bool IsStopWord(std::string_view word) const;
 
     std::vector<std::string_view> SplitIntoWordsNoStopView(std::string_view text) const;
 
+    std::pmr::vector<std::string_view> SplitIntoWordsNoStopView(std::string_view text, std::pmr::memory_resource* resource) const;
+
     // по умолчанию ParseQuery запустится как однопоточная;
     // распараллеленная версия ParseQuery требует указания второго параметра true
-    PlusMinusWords ParseQuery(std::string_view raw_query, bool is_parallel_need = false) const;
+    // resource -- где разместить слова запроса (например, арена запроса ScratchArena);
+    // однопоточная версия сразу находит постинги слов (ResolvePostings)
+    PlusMinusWords ParseQuery(std::string_view raw_query, bool is_parallel_need = false,
+                              std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+    // заполняет synonym_words по уже разобранным плюс-словам
+    void AddSynonymWords(PlusMinusWords& query_words) const;
+
+    // находит постинги слов разобранного запроса (plus_postings и т. д.)
+    void ResolvePostings(PlusMinusWords& query_words) const;
+
+    static uint64_t NextIndexEpoch();
+
+    // вынимает из запроса фразы в кавычках, возвращает остальные слова запроса
+    std::pmr::vector<std::string_view> ParsePhrases(std::string_view raw_query, std::vector<Phrase>& phrases, std::pmr::memory_resource* resource) const;
+
+    // слова словаря, подходящие под шаблон, в лексикографическом порядке, но не больше max_terms:
+    // снимок словаря упорядочен, поэтому смотрим только диапазон слов с префиксом шаблона
+    std::vector<std::string_view> ExpandPattern(std::string_view pattern, size_t max_terms) const;
+
+    // постинги нескольких слов, слитые как постинги одного слова: [внутренний id -- сумма TF] по возрастанию id
+    std::vector<std::pair<int, double>> MergePostings(const std::vector<std::string_view>& terms, uint64_t& postings_scanned) const;
+
+    // слова словаря на наименьшем расстоянии от word, на котором совпадения есть (не дальше допустимого для длины word),
+    // не больше MAX_PATTERN_EXPANSIONS: кандидатов дает индекс удалений словаря, автомат Левенштейна их проверяет
+    std::vector<std::string_view> ExpandFuzzyWord(std::string_view word) const;
+
+    std::shared_ptr<const TermDictionary> GetTermDictionary() const;
+
+    // переносит в снимок словаря слова, которые появились в TF_by_term_ или пропали из него
+    void UpdateTermDictionary(std::vector<std::string_view> added_terms, size_t removed_term_count);
+
+    std::shared_ptr<const std::vector<double>> GetLengthNorms() const;
+
+    // для MatchDocument шаблоны, слова с опечатками и синонимы просто заменяются подходящими словами словаря
+    void ExpandQueryToWords(PlusMinusWords& query_words) const;
+
+    // внутренние id (по возрастанию) документов, содержащих все фразы запроса; nullopt -- фраз в запросе нет
+    std::optional<std::vector<int>> FindPhraseMatches(const PlusMinusWords& query_words) const;
+
+    // убирает документ из битмапов статусов и таблицы id; постинги чистит вызывающий RemoveDocument
+    void ForgetDocument(int document_id);
+
+    // удаляет документ, оставляя его постинги надгробиями до PurgeRemovedDocuments
+    void TombstoneDocument(int document_id, int internal_id);
+
+    // N для IDF: пока постинги удаленных RemoveDocuments документов не вычищены, они входят в df слова,
+    // поэтому входят и в N -- иначе df может превысить N и IDF общего слова станет отрицательным
+    size_t GetIdfDocumentCount() const;
+
+    // снимок document_order_ для текущей эпохи индекса, при необходимости строит новый
+    std::shared_ptr<const DocumentOrder> GetDocumentOrder() const;
 
+    // внутренний id живого документа; нет такого -- out_of_range
+    int GetInternalId(int document_id) const;
+
+    // строка колонок принадлежит живому документу, а не удаленному, еще не освобожденному Compact
+    bool IsLiveDocument(int internal_id) const;
+
+    // MatchDocument по разобранному запросу; query_words дополняется раскрытыми шаблонами и синонимами
+    Matching MatchParsedQuery(PlusMinusWords& query_words, int document_id, QueryStats* stats) const;
+
+    // добавляет уже проверенный документ с посчитанным рейтингом: AddDocument, копирование и Compact
+    void IndexDocument(int document_id, std::string_view document, DocumentStatus status, int rating);
+
+    // бросает, если после добавления документа длиной document_size индекс выйдет за бюджет
+    void CheckMemoryBudget(size_t document_size);
+
+    // фильтр, спущенный к колонкам атрибутов: проверяется по внутреннему id документа;
+    // статусы -- битмапами, диапазоны -- чтением колонок, предикат вызывается последним и только если он не AnyDocument
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const PlusMinusWords& query_words, Predicate filter) const;
+    class ColumnFilter {
+    public:
+        ColumnFilter(const SearchServer& search_server, const DocumentFilter<Predicate>& filter);
+
+        // внутри может лежать указатель на собственный битмап -- копировать нельзя
+        ColumnFilter(const ColumnFilter&) = delete;
+        ColumnFilter& operator=(const ColumnFilter&) = delete;
+
+        // фильтр заведомо ничего не пропустит -- по постингам можно не ходить
+        bool IsEmpty() const { return is_empty_; }
+
+        bool operator()(int internal_id) const;
+
+    private:
+        const SearchServer& search_server_;
+        const DocumentFilter<Predicate> filter_;
+        Bitmap merged_candidates_;
+        const Bitmap* candidates_ = nullptr; // nullptr -- подходит любой статус
+        bool is_empty_ = false;
+    };
+
+    // на этапе компиляции разбирает, что передано: готовое выражение DocumentFilter или произвольный предикат
+    template <typename Predicate>
+    auto MakeColumnFilter(Predicate filter) const;
+
+    // ранжирование, сортировка и первые MAX_RESULT_DOCUMENT_COUNT документов разобранного запроса
+    template <typename Predicate>
+    std::vector<Document> FindTopParsedDocuments(const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                 const QueryInterrupt* interrupt) const;
+
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocumentsByFilter(ExecutionPolicy policy, std::string_view raw_query, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                   const QueryInterrupt* interrupt = nullptr) const;
 
+    // выбирает функцию ранжирования один раз на запрос, дальше она известна циклам по постингам на этапе компиляции;
+    // найденные документы лежат в памяти query_words.GetResource()
     template <typename ExecutionPolicy, typename Predicate>
-    std::vector<Document> FindAllDocuments(ExecutionPolicy policy, const PlusMinusWords& query_words, Predicate filter) const;
+    std::pmr::vector<Document> FindAllDocuments(ExecutionPolicy policy, const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                           const QueryInterrupt* interrupt = nullptr) const;
+
+    // счетчики копятся в локальных переменных и записываются в stats один раз в конце, если stats != nullptr;
+    // interrupt != nullptr -- ранжирование может остановиться на полпути, вычеркивание минус-словами выполняется всегда
+    template <typename Ranking, typename Predicate>
+    std::pmr::vector<Document> ScoreDocuments(const Ranking& ranking, const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                         const QueryInterrupt* interrupt) const;
+
+    template <typename ExecutionPolicy, typename Ranking, typename Predicate>
+    std::pmr::vector<Document> ScoreDocuments(ExecutionPolicy policy, const Ranking& ranking, const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                         const QueryInterrupt* interrupt) const;
+
+    // вклад одного слова запроса во все прошедшие фильтр документы его постингов (пар [внутренний id -- TF]):
+    // вызывает accumulate(internal_id, relevance) и возвращает, сколько постингов отброшено фильтром
+    // (0, если count_rejected == false -- тогда цикл их не считает)
+    template <typename Ranking, typename Postings, typename Predicate, typename Accumulate>
+    static uint64_t ScorePostings(const Ranking& ranking, const Postings& postings, double idf, const ColumnFilter<Predicate>& column_filter, Accumulate accumulate,
+                                  const QueryInterrupt* interrupt, bool count_rejected);
+
+    void CountResolvedWords(const PlusMinusWords& query_words, QueryStats* stats) const;
+
+    template <typename Predicate>
+    SearchPage FindPageByFilter(std::string_view raw_query, const std::optional<SearchCursor>& cursor, int page_size, const ColumnFilter<Predicate>& column_filter) const;
+
+    // полный порядок документов в постраничной выдаче
+    static bool IsBeforeInResults(const Document& lhs, const Document& rhs);
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -121,11 +492,36 @@ private:
     bool IsRecurringDocumentId(const int document_id) const;
 
     void ThrowSpecialSymbolInText(std::string_view text) const;
+
+    void ThrowWildcardWithoutPrefix(std::string_view pattern) const;
+};
+
+// запрос, разобранный SearchServer::PrepareQuery; только перемещается. Слова смотрят в собственную копию строки запроса,
+// постинги -- в индекс сервера, поэтому запрос действителен, пока сервер не изменился (см. RefreshQuery)
+class SearchServer::PreparedQuery {
+public:
+
+    const std::string& GetRawQuery() const {
+        return *raw_query_;
+    }
+
+private:
+    friend class SearchServer;
+
+    explicit PreparedQuery(std::string_view raw_query)
+        : raw_query_(std::make_unique<std::string>(raw_query)) {
+    }
+
+    std::unique_ptr<std::string> raw_query_; // в куче, чтобы вью слов пережили перемещение запроса
+    PlusMinusWords words_;
+    uint64_t epoch_ = 0;
 };
 
 template<typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(MakeSetStopWords(stop_words)) {
-    for (std::string_view word : stop_words_) {
+SearchServer::SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource /* = std::pmr::get_default_resource() */)
+    : memory_resource_(resource)
+    , stop_words_(stop_words) {
+    for (std::string_view word : stop_words) {
         ThrowSpecialSymbolInText(word);
     }
 }
@@ -134,160 +530,584 @@ SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(Make
 void AddDocument(SearchServer& search_server, int document_id, std::string_view document, const DocumentStatus& status, const std::vector<int>& ratings);
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Predicate filter) const {
-    const PlusMinusWords prepared_query = ParseQuery(raw_query);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Predicate filter, QueryStats* stats /* = nullptr */) const {
+    return FindTopDocumentsByFilter(std::execution::seq, raw_query, MakeColumnFilter(filter), stats);
+}
 
-    auto matched_documents = FindAllDocuments(prepared_query, filter);
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, Predicate filter, QueryStats* stats /* = nullptr */) const {
+    return FindTopDocumentsByFilter(policy, raw_query, MakeColumnFilter(filter), stats);
+}
 
-    sort(matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) > PRECISE) {
-                    return lhs.relevance > rhs.relevance;
-                }
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus given_status /* = DocumentStatus::ACTUAL */, QueryStats* stats /* = nullptr */) const {
+    return FindTopDocumentsByFilter(policy, raw_query, MakeColumnFilter(StatusIn({given_status})), stats);
+}
+
+template <typename Predicate>
+SearchResult SearchServer::FindTopDocumentsWithDeadline(std::string_view raw_query, const QueryDeadline& deadline, Predicate filter) const {
+    const QueryInterrupt interrupt(deadline);
+    SearchResult result;
+    result.documents = FindTopDocumentsByFilter(std::execution::seq, raw_query, MakeColumnFilter(filter), nullptr, &interrupt);
+    result.is_truncated = interrupt.IsStopped();
+    return result;
+}
+
+template <typename Predicate>
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(std::string_view raw_query, QueryDeadline deadline, Predicate filter) const {
+    // вью на запрос может не дожить до начала работы потока, поэтому копируем
+    return std::async(std::launch::async, [this, query = std::string(raw_query), deadline = std::move(deadline), filter]() {
+        return FindTopDocumentsWithDeadline(query, deadline, filter);
+    });
+}
+
+template <typename Predicate>
+SearchPage SearchServer::FindTopDocumentsAfter(std::string_view raw_query, const std::optional<SearchCursor>& cursor, int page_size, Predicate filter) const {
+    return FindPageByFilter(raw_query, cursor, page_size, MakeColumnFilter(filter));
+}
+
+template <typename Predicate>
+SearchPage SearchServer::FindPageByFilter(std::string_view raw_query, const std::optional<SearchCursor>& cursor, int page_size, const ColumnFilter<Predicate>& column_filter) const {
+    if (page_size <= 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+
+    ScratchArena::Scope scratch;
+    const PlusMinusWords prepared_query = ParseQuery(raw_query, false, scratch.GetResource());
+
+    if (column_filter.IsEmpty()) {
+        return {};
+    }
+
+    std::pmr::vector<Document> candidates = FindAllDocuments(std::execution::seq, prepared_query, column_filter, nullptr);
+
+    // релевантность известна только после прохода по всем плюс-словам, поэтому документы до курсора отсекаем здесь
+    if (cursor) {
+        const Document cursor_document(cursor->document_id, cursor->relevance, cursor->rating);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [&cursor_document](const Document& document) {
+                                            return !IsBeforeInResults(cursor_document, document);
+                                        }),
+                         candidates.end());
+    }
+
+    // частичная сортировка: O(N log K) вместо сортировки всех кандидатов
+    const size_t page_end = std::min(candidates.size(), static_cast<size_t>(page_size));
+    std::partial_sort(candidates.begin(), candidates.begin() + page_end, candidates.end(), IsBeforeInResults);
 
-                return lhs.rating > rhs.rating;
+    SearchPage page;
+    const bool has_next_page = candidates.size() > page_end;
+    page.documents.assign(candidates.begin(), candidates.begin() + page_end);
+    if (has_next_page) {
+        page.next_cursor = MakeSearchCursor(page.documents.back());
+    }
+
+    return page;
+}
+
+template <typename Predicate>
+auto SearchServer::MakeColumnFilter(Predicate filter) const {
+    if constexpr (is_document_filter_v<Predicate>) {
+        return ColumnFilter<typename Predicate::PredicateType>(*this, filter);
+    } else {
+        return ColumnFilter<Predicate>(*this, Where(filter));
+    }
+}
+
+template <typename Predicate>
+SearchServer::ColumnFilter<Predicate>::ColumnFilter(const SearchServer& search_server, const DocumentFilter<Predicate>& filter)
+    : search_server_(search_server)
+    , filter_(filter) {
+
+    is_empty_ = filter_.IsEmpty();
+
+    // в постингах есть надгробия: тогда и фильтр без статусов проверяется по битмапам, где удаленных документов уже нет
+    if (filter_.status_mask == ALL_STATUSES_MASK && search_server_.unpurged_documents_.empty()) {
+        return;
+    }
+
+    // один статус -- смотрим прямо в его битмап; несколько -- один раз объединяем битмапы на запрос
+    int candidates_count = 0;
+    for (int status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+        if (!filter_.HasStatus(static_cast<DocumentStatus>(status))) {
+            continue;
+        }
+
+        candidates_count += search_server_.status_counts_[status];
+        if (candidates_ == nullptr) {
+            candidates_ = &search_server_.status_bitmaps_[status];
+        } else {
+            if (candidates_ != &merged_candidates_) {
+                merged_candidates_ = *candidates_;
+                candidates_ = &merged_candidates_;
             }
-        );
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+            merged_candidates_ |= search_server_.status_bitmaps_[status];
+        }
     }
 
-    return matched_documents;
+    is_empty_ = is_empty_ || candidates_count == 0;
+}
+
+template <typename Predicate>
+bool SearchServer::ColumnFilter<Predicate>::operator()(int internal_id) const {
+    if (candidates_ != nullptr && !candidates_->Test(internal_id)) {
+        return false;
+    }
+
+    const int rating = search_server_.ratings_[internal_id];
+    if (filter_.IsRatingRestricted() && (rating < filter_.min_rating || rating > filter_.max_rating)) {
+        return false;
+    }
+
+    const int document_id = search_server_.external_ids_[internal_id];
+    if (filter_.IsIdRestricted() && (document_id < filter_.min_id || document_id > filter_.max_id)) {
+        return false;
+    }
+
+    if constexpr (std::is_same_v<Predicate, AnyDocument>) {
+        return true;
+    } else {
+        return filter_.predicate(document_id, search_server_.statuses_[internal_id], rating);
+    }
 }
 
 template <typename ExecutionPolicy, typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, Predicate filter) const {
+std::vector<Document> SearchServer::FindTopDocumentsByFilter(ExecutionPolicy policy, std::string_view raw_query, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                           const QueryInterrupt* interrupt /* = nullptr */) const {
+    TRACE_SPAN(TraceSpan::FIND_TOP_DOCUMENTS);
 
-    if (std::is_same_v<std::execution::sequenced_policy, ExecutionPolicy>) {
-        return FindTopDocuments(raw_query, filter);
+    if (stats != nullptr) {
+        *stats = {};
     }
+    PhaseTimer total_timer(stats != nullptr ? &stats->total_ns : nullptr);
 
-    // тут два вектора с возможно повторяющимися + и - словами
-    SearchServer::PlusMinusWords prepared_query = ParseQuery(raw_query, true);
+    auto comparator = [](const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) > PRECISE) {
+            return lhs.relevance > rhs.relevance;
+        }
 
-    // очищаем от повтором, потому что релевандность высчитывается на уникальных плюс-словах запроса
-    // почему очищаю тут -- да потому что при вызове этой очистки в параллельной ипостаси ParseQuery я получаю непрохождение по времени
-    // с соотношением мой код/учителя код = 0.9, а если тут вызываю, то 0.5 и соответственно прохожу по времени
-    prepared_query.RemovePlusWordsDublicates();
+        return lhs.rating > rhs.rating;
+    };
 
-    auto matched_documents = FindAllDocuments(std::execution::par, prepared_query, filter);
+    // все временные данные запроса -- слова, накопленные релевантности, кандидаты -- лежат в арене потока,
+    // из глобальной кучи выделяется только возвращаемый вектор
+    ScratchArena::Scope scratch;
+    std::pmr::vector<Document> matched_documents(scratch.GetResource());
 
-    sort(std::execution::par, matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) > PRECISE) {
-                    return lhs.relevance > rhs.relevance;
-                }
+    if constexpr (std::is_same_v<std::execution::sequenced_policy, std::decay_t<ExecutionPolicy>>) {
+        PlusMinusWords prepared_query(scratch.GetResource());
+        {
+            PhaseTimer parse_timer(stats != nullptr ? &stats->parse_ns : nullptr);
+            prepared_query = ParseQuery(raw_query, false, scratch.GetResource());
+        }
+        return FindTopParsedDocuments(prepared_query, column_filter, stats, interrupt);
+    } else {
+        SearchServer::PlusMinusWords prepared_query(scratch.GetResource());
+        {
+            PhaseTimer parse_timer(stats != nullptr ? &stats->parse_ns : nullptr);
+
+            // тут два вектора с возможно повторяющимися + и - словами
+            prepared_query = ParseQuery(raw_query, true, scratch.GetResource());
+
+            // очищаем от повтором, потому что релевандность высчитывается на уникальных плюс-словах запроса
+            // почему очищаю тут -- да потому что при вызове этой очистки в параллельной ипостаси ParseQuery я получаю непрохождение по времени
+            // с соотношением мой код/учителя код = 0.9, а если тут вызываю, то 0.5 и соответственно прохожу по времени
+            prepared_query.RemovePlusWordsDublicates();
+        }
+        CountResolvedWords(prepared_query, stats);
 
-                return lhs.rating > rhs.rating;
-            }
-        );
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        if (column_filter.IsEmpty()) {
+            return {};
+        }
+
+        matched_documents = FindAllDocuments(std::execution::par, prepared_query, column_filter, stats, interrupt);
+
+        TRACE_SPAN(TraceSpan::SORT);
+        PhaseTimer sort_timer(stats != nullptr ? &stats->sort_ns : nullptr);
+        sort(std::execution::par, matched_documents.begin(), matched_documents.end(), comparator);
     }
 
-    return matched_documents;
+    if (stats != nullptr) {
+        stats->candidates_sorted = matched_documents.size();
+    }
+
+    const size_t result_count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    return std::vector<Document>(matched_documents.begin(), matched_documents.begin() + result_count);
 }
 
-template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus given_status /* = DocumentStatus::ACTUAL */) const {
-    if (std::is_same_v<std::execution::sequenced_policy, ExecutionPolicy>) {
-        return FindTopDocuments(raw_query,
-                                [given_status](int document_id, DocumentStatus status, int rating) {
-                                    return status == given_status;
-                                });
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopParsedDocuments(const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                           const QueryInterrupt* interrupt) const {
+    CountResolvedWords(query_words, stats);
+
+    if (column_filter.IsEmpty()) {
+        return {};
     }
 
-    return FindTopDocuments(std::execution::par, raw_query,
-                                [given_status](int document_id, DocumentStatus status, int rating) {
-                                    return status == given_status;
-                                });
+    // временные данные -- в ресурсе слов запроса, то есть в арене вызывающего
+    std::pmr::vector<Document> matched_documents = FindAllDocuments(std::execution::seq, query_words, column_filter, stats, interrupt);
+
+    {
+        TRACE_SPAN(TraceSpan::SORT);
+        PhaseTimer sort_timer(stats != nullptr ? &stats->sort_ns : nullptr);
+        sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
+            if (std::abs(lhs.relevance - rhs.relevance) > PRECISE) {
+                return lhs.relevance > rhs.relevance;
+            }
+
+            return lhs.rating > rhs.rating;
+        });
+    }
+
+    if (stats != nullptr) {
+        stats->candidates_sorted = matched_documents.size();
+    }
 
+    const size_t result_count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    return std::vector<Document>(matched_documents.begin(), matched_documents.begin() + result_count);
 }
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const PlusMinusWords& query_words, Predicate filter) const {
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, Predicate filter, QueryStats* stats /* = nullptr */) const {
+    TRACE_SPAN(TraceSpan::FIND_TOP_DOCUMENTS);
+
+    if (stats != nullptr) {
+        *stats = {};
+    }
+    PhaseTimer total_timer(stats != nullptr ? &stats->total_ns : nullptr);
+
+    ScratchArena::Scope scratch;
+    PlusMinusWords query_words(scratch.GetResource());
+    {
+        PhaseTimer parse_timer(stats != nullptr ? &stats->parse_ns : nullptr);
+        if (query.epoch_ == index_epoch_) {
+            query_words = query.words_;
+        } else {
+            query_words = ParseQuery(*query.raw_query_, false, scratch.GetResource());
+        }
+    }
+
+    return FindTopParsedDocuments(query_words, MakeColumnFilter(filter), stats, nullptr);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                   const QueryInterrupt* interrupt /* = nullptr */) const {
+    if (ranking_function_ == RankingFunction::BM25) {
+        return ScoreDocuments(policy, Bm25Ranking(bm25_params_, GetLengthNorms()), query_words, column_filter, stats, interrupt);
+    }
+    return ScoreDocuments(policy, TfIdfRanking{}, query_words, column_filter, stats, interrupt);
+}
+
+template <typename Ranking, typename Postings, typename Predicate, typename Accumulate>
+uint64_t SearchServer::ScorePostings(const Ranking& ranking, const Postings& postings, double idf, const ColumnFilter<Predicate>& column_filter, Accumulate accumulate,
+                                     const QueryInterrupt* interrupt, bool count_rejected) {
+    // цикл по постингам собирается в вариантах со сроком и без, со счетом отброшенных и без:
+    // без срока и статистики в нем нет ни одной лишней операции
+    auto score = [&](auto should_stop, auto is_counting) {
+        uint64_t rejected = 0;
+
+        if constexpr (std::is_same_v<Ranking, TfIdfRanking>) {
+            for (const auto& [internal_id, tf] : postings) { // будем идти по предпосчитанным постингам слова и наращивать релевантность документам по их id по офрмуле IDF-TF.
+                if (should_stop()) {
+                    break;
+                }
+                if (column_filter(internal_id)) { // если документ соответсвует фильтру, рассчитаем ему релевантность, иначе нет смысла считать, чтобы потом не удалять пусть и релевантные документы, не соответствующие фильтру
+                    accumulate(internal_id, idf * tf);
+                } else if constexpr (decltype(is_counting)::value) {
+                    ++rejected;
+                }
+            }
+        } else {
+            // прошедшие фильтр постинги копятся в блок, который ранжирование считает одним векторизуемым циклом
+            int internal_ids[Ranking::BLOCK_SIZE];
+            double term_frequencies[Ranking::BLOCK_SIZE];
+            double scores[Ranking::BLOCK_SIZE];
+            size_t count = 0;
+
+            auto flush = [&]() {
+                ranking.ScoreBlock(idf, internal_ids, term_frequencies, scores, count);
+                for (size_t i = 0; i < count; ++i) {
+                    accumulate(internal_ids[i], scores[i]);
+                }
+                count = 0;
+            };
 
-    /* Рассчитываем IDF каждого плюс-слова в запросе:
-    1) количество документов document_order_.size() делим на количество документов, где это слово встречается;
-    2) берем от полученного значения log.
+            for (const auto& [internal_id, tf] : postings) {
+                if (should_stop()) {
+                    break;
+                }
+                if (column_filter(internal_id)) {
+                    internal_ids[count] = internal_id;
+                    term_frequencies[count] = tf;
+                    if (++count == Ranking::BLOCK_SIZE) {
+                        flush();
+                    }
+                } else if constexpr (decltype(is_counting)::value) {
+                    ++rejected;
+                }
+            }
+            // неполный хвост блока; пустой не передаем -- в массивах тогда ничего не записано
+            if (count != 0) {
+                flush();
+            }
+        }
+
+        return rejected;
+    };
+
+    auto score_counting = [&](auto should_stop) {
+        return count_rejected ? score(should_stop, std::true_type{}) : score(should_stop, std::false_type{});
+    };
+
+    if (interrupt == nullptr) {
+        return score_counting([]() { return false; });
+    }
+
+    // срок смотрим раз в QueryInterrupt::CHECK_INTERVAL постингов: часы дороже одного постинга
+    return score_counting([interrupt, visited = size_t{0}]() mutable {
+        return ++visited % QueryInterrupt::CHECK_INTERVAL == 0 && interrupt->ShouldStop();
+    });
+}
+
+template <typename Ranking, typename Predicate>
+std::pmr::vector<Document> SearchServer::ScoreDocuments(const Ranking& ranking, const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                 const QueryInterrupt* interrupt) const {
+
+    /* Рассчитываем IDF каждого плюс-слова в запросе по количеству документов GetIdfDocumentCount()
+    и количеству документов, где это слово встречается (у TF-IDF -- log их отношения, у BM25 -- сглаженный вариант).
     Функция AddDocument построила TF_, где каждому слову отнесено множество документов, где оно встречается.
     */
 
     double idf;
-    std::map<int, double> IDF_TF; // в результате получим соответствие документ -- его релевантность, посчитанная по алгоритму IDF-TF.
-
-    for (std::string_view word : query_words.plus_words) {
-        if (TF_by_term_.count(word) != 0) { // если плюс-слово запроса есть в TF_, значит по TF_.at(плюс-слово запроса) мы получим все id документов, где это слово имеет вес tf, эти документы интересы; а по TF_.at(word).size() поймем, в скольких документах это слово есть.
-            
-            idf = log(static_cast<double>(document_order_.size()) / TF_by_term_.at(word).size());
-            
-            for (const auto& [document_id, tf] : TF_by_term_.at(word)) { // будем идти по предпосчитанному TF_.at(плюс-слово запроса) и наращивать релевантность документам по их id по офрмуле IDF-TF.
-                const DocumentData& document_data = document_info_.at(document_id);
-                if (filter(document_id, document_data.status, document_data.rating)) { // если документ соответсвует предикату, рассчитаем ему релевантность по алгоритму IDF-TF, иначе нет смысла считать, чтобы потом не удалять пусть и релевантные документы, не соответствующие предикату
-                    IDF_TF[document_id] += idf * tf;
+    std::pmr::map<int, double> IDF_TF(query_words.GetResource()); // в результате получим соответствие внутренний id документа -- его релевантность, посчитанная функцией ранжирования.
+    // счетчики ведутся, только если статистику запросили
+    const bool is_counting = stats != nullptr;
+    uint64_t postings_scanned = 0;
+    uint64_t rejected_by_filter = 0;
+
+    {
+        TRACE_SPAN(TraceSpan::SCORE);
+        PhaseTimer score_timer(stats != nullptr ? &stats->score_ns : nullptr);
+        auto accumulate = [&IDF_TF](int internal_id, double relevance) { IDF_TF[internal_id] += relevance; };
+
+        // синоним слова запроса ранжируется как само слово, но его вклад умножается на weight
+        auto is_interrupted = [interrupt]() { return interrupt != nullptr && interrupt->ShouldStop(); };
+
+        // постинги слов уже найдены при разборе запроса (ResolvePostings); nullptr -- слова нет в индексе
+        auto add_word_relevance = [&](const TermPostings* postings, double weight) {
+            if (postings != nullptr && !is_interrupted()) { // по постингам слова получим все id документов, где это слово имеет вес tf, а по их количеству поймем, в скольких документах это слово есть.
+                idf = weight * ranking.ComputeIdf(GetIdfDocumentCount(), postings->size());
+                if (is_counting) {
+                    postings_scanned += postings->size();
                 }
+                rejected_by_filter += ScorePostings(ranking, *postings, idf, column_filter, accumulate, interrupt, is_counting);
             }
+        };
+
+        for (const TermPostings* postings : query_words.plus_postings) {
+            add_word_relevance(postings, 1.0);
+        }
+        for (const TermPostings* postings : query_words.synonym_postings) {
+            add_word_relevance(postings, synonym_weight_);
+        }
+
+        // шаблон и слово с опечаткой ранжируются как одно слово: их постинги -- объединение постингов раскрытых слов
+        auto add_expanded_relevance = [&](const std::vector<std::string_view>& terms) {
+            // раскрылось в одно слово -- его постинги ранжируются как есть, без копии в объединение
+            if (terms.size() == 1) {
+                add_word_relevance(TF_by_term_.Find(terms[0]), 1.0);
+                return;
+            }
+            if (is_interrupted()) {
+                return;
+            }
+            const auto postings = MergePostings(terms, postings_scanned);
+            if (postings.empty()) {
+                return;
+            }
+
+            idf = ranking.ComputeIdf(GetIdfDocumentCount(), postings.size());
+            rejected_by_filter += ScorePostings(ranking, postings, idf, column_filter, accumulate, interrupt, is_counting);
+        };
+
+        for (std::string_view pattern : query_words.plus_patterns) {
+            add_expanded_relevance(ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS));
+        }
+        for (std::string_view word : query_words.fuzzy_words) {
+            add_expanded_relevance(ExpandFuzzyWord(word));
         }
     }
 
+    const uint64_t documents_scored = IDF_TF.size();
+
     // теперь надо пройтись по минус словам и посмотреть при помощи TF_, какие id документов есть по этому слову, и вычеркнуть их из выдачи.
 
-    for (std::string_view word : query_words.minus_words) {
-        if (TF_by_term_.count(word) != 0) {
-            for (const auto& [documents_id, _] : TF_by_term_.at(word)) {
-                IDF_TF.erase(documents_id);
+    {
+        TRACE_SPAN(TraceSpan::FILTER);
+        PhaseTimer filter_timer(stats != nullptr ? &stats->filter_ns : nullptr);
+        for (const TermPostings* postings : query_words.minus_postings) {
+            if (postings != nullptr) {
+                for (const auto& [internal_id, _] : *postings) {
+                    IDF_TF.erase(internal_id);
+                }
+            }
+        }
+
+        // минус-шаблон не ограничиваем: иначе часть документов с запрещенными словами осталась бы в выдаче
+        for (std::string_view pattern : query_words.minus_patterns) {
+            for (std::string_view word : ExpandPattern(pattern, TF_by_term_.Size())) {
+                for (const auto& [internal_id, _] : *TF_by_term_.Find(word)) {
+                    IDF_TF.erase(internal_id);
+                }
             }
         }
     }
 
-    std::vector<Document> result;
+    if (stats != nullptr) {
+        stats->postings_scanned = postings_scanned;
+        stats->documents_scored = documents_scored;
+        stats->rejected_by_filter = rejected_by_filter;
+        stats->rejected_by_minus_words = documents_scored - IDF_TF.size();
+    }
+
+    std::optional<std::vector<int>> phrase_matches;
+    if (!query_words.phrases.empty() && !IDF_TF.empty()) {
+        TRACE_SPAN(TraceSpan::FILTER);
+        PhaseTimer filter_timer(stats != nullptr ? &stats->filter_ns : nullptr);
+        phrase_matches = FindPhraseMatches(query_words);
+    }
+
+    std::pmr::vector<Document> result(query_words.GetResource());
+    result.reserve(IDF_TF.size());
 
-    for (const auto& [document_id, relevance] : IDF_TF) {
-        result.push_back({document_id, relevance, document_info_.at(document_id).rating});
+    for (const auto& [internal_id, relevance] : IDF_TF) {
+        if (phrase_matches && !std::binary_search(phrase_matches->begin(), phrase_matches->end(), internal_id)) {
+            continue;
+        }
+        result.push_back({external_ids_[internal_id], relevance, ratings_[internal_id]});
     }
 
     return result;
 }
 
-template <typename ExecutionPolicy, typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, const PlusMinusWords& query_words, Predicate filter) const {
+template <typename ExecutionPolicy, typename Ranking, typename Predicate>
+std::pmr::vector<Document> SearchServer::ScoreDocuments(ExecutionPolicy policy, const Ranking& ranking, const PlusMinusWords& query_words, const ColumnFilter<Predicate>& column_filter, QueryStats* stats,
+                                                 const QueryInterrupt* interrupt) const {
 
-    if (std::is_same_v<std::execution::sequenced_policy, ExecutionPolicy>) {
-        return FindAllDocuments(query_words, filter);
+    if constexpr (std::is_same_v<std::execution::sequenced_policy, std::decay_t<ExecutionPolicy>>) {
+        return ScoreDocuments(ranking, query_words, column_filter, stats, interrupt);
     }
 
     ConcurrentMap<int, double> IDF_TF(157);
+    // слова обрабатываются параллельно: каждое считает свои счетчики и прибавляет их один раз,
+    // и только если статистику запросили -- иначе атомарные сложения были бы чистой платой за каждое слово
+    const bool is_counting = stats != nullptr;
+    std::atomic<uint64_t> postings_scanned{0};
+    std::atomic<uint64_t> rejected_by_filter{0};
 
-    auto calculator = [&IDF_TF, this, &filter](std::string_view word) {
-        if (this->TF_by_term_.count(word) != 0) {
-            
-            double idf = log(static_cast<double>(this->document_order_.size()) / this->TF_by_term_.at(word).size());
-            
-            for (const auto& [document_id, tf] : this->TF_by_term_.at(word)) {
-                const DocumentData& document_data = this->document_info_.at(document_id);
-                if (filter(document_id, document_data.status, document_data.rating)) {
-                    IDF_TF[document_id].ref_to_value += idf * tf;
-                }
+    auto accumulate = [&IDF_TF](int internal_id, double relevance) { IDF_TF[internal_id].ref_to_value += relevance; };
+
+    auto is_interrupted = [interrupt]() { return interrupt != nullptr && interrupt->ShouldStop(); };
+
+    auto calculator = [this, &ranking, &column_filter, &accumulate, &postings_scanned, &rejected_by_filter, interrupt, &is_interrupted, is_counting](std::string_view word, double weight) {
+        const TermPostings* postings = this->TF_by_term_.Find(word);
+        if (postings != nullptr && !is_interrupted()) {
+            const double idf = weight * ranking.ComputeIdf(this->GetIdfDocumentCount(), postings->size());
+            const uint64_t rejected = ScorePostings(ranking, *postings, idf, column_filter, accumulate, interrupt, is_counting);
+
+            if (is_counting) {
+                postings_scanned.fetch_add(postings->size(), std::memory_order_relaxed);
+                rejected_by_filter.fetch_add(rejected, std::memory_order_relaxed);
             }
         }
     };
 
     auto eraser = [&IDF_TF, this](std::string_view word) {
-        if (this->TF_by_term_.count(word) != 0) {
-            for (const auto& [documents_id, _] : TF_by_term_.at(word)) {
-                IDF_TF.erase(documents_id);
+        if (const TermPostings* postings = this->TF_by_term_.Find(word)) {
+            for (const auto& [internal_id, _] : *postings) {
+                IDF_TF.erase(internal_id);
             }
         }
     };
 
-    for_each(std::execution::par, query_words.plus_words.begin(), query_words.plus_words.end(), calculator);
+    auto expanded_calculator = [this, &ranking, &column_filter, &accumulate, &postings_scanned, &rejected_by_filter, interrupt, &is_interrupted, is_counting,
+                                &calculator](const std::vector<std::string_view>& terms) {
+        if (terms.size() == 1) {
+            calculator(terms[0], 1.0);
+            return;
+        }
+        if (is_interrupted()) {
+            return;
+        }
+        uint64_t scanned = 0;
+        const auto postings = this->MergePostings(terms, scanned);
+        if (is_counting) {
+            postings_scanned.fetch_add(scanned, std::memory_order_relaxed);
+        }
+        if (postings.empty()) {
+            return;
+        }
+
+        const double idf = ranking.ComputeIdf(this->GetIdfDocumentCount(), postings.size());
+        const uint64_t rejected = ScorePostings(ranking, postings, idf, column_filter, accumulate, interrupt, is_counting);
+        if (is_counting) {
+            rejected_by_filter.fetch_add(rejected, std::memory_order_relaxed);
+        }
+    };
+
+    auto pattern_eraser = [&eraser, this](std::string_view pattern) {
+        const std::vector<std::string_view> words = this->ExpandPattern(pattern, this->TF_by_term_.Size());
+        for_each(std::execution::par, words.begin(), words.end(), eraser);
+    };
+
+    {
+        TRACE_SPAN(TraceSpan::SCORE);
+        PhaseTimer score_timer(stats != nullptr ? &stats->score_ns : nullptr);
+        for_each(std::execution::par, query_words.plus_words.begin(), query_words.plus_words.end(),
+                 [&calculator](std::string_view word) { calculator(word, 1.0); });
+        for_each(std::execution::par, query_words.synonym_words.begin(), query_words.synonym_words.end(),
+                 [this, &calculator](std::string_view word) { calculator(word, this->synonym_weight_); });
+        for_each(std::execution::par, query_words.plus_patterns.begin(), query_words.plus_patterns.end(),
+                 [this, &expanded_calculator](std::string_view pattern) { expanded_calculator(this->ExpandPattern(pattern, MAX_PATTERN_EXPANSIONS)); });
+        for_each(std::execution::par, query_words.fuzzy_words.begin(), query_words.fuzzy_words.end(),
+                 [this, &expanded_calculator](std::string_view word) { expanded_calculator(this->ExpandFuzzyWord(word)); });
+    }
 
-    for_each(std::execution::par, query_words.minus_words.begin(), query_words.minus_words.end(), eraser);
+    // счет документов до и после вычеркивания требует обхода корзин, поэтому делаем его только по запросу
+    const uint64_t documents_scored = stats != nullptr ? IDF_TF.Size() : 0;
 
-    std::vector<Document> result;
+    {
+        TRACE_SPAN(TraceSpan::FILTER);
+        PhaseTimer filter_timer(stats != nullptr ? &stats->filter_ns : nullptr);
+        for_each(std::execution::par, query_words.minus_words.begin(), query_words.minus_words.end(), eraser);
+        for_each(std::execution::par, query_words.minus_patterns.begin(), query_words.minus_patterns.end(), pattern_eraser);
+    }
+
+    const std::map<int, double> relevances = IDF_TF.BuildOrdinaryMap();
+
+    std::optional<std::vector<int>> phrase_matches;
+    if (!query_words.phrases.empty() && !relevances.empty()) {
+        TRACE_SPAN(TraceSpan::FILTER);
+        PhaseTimer filter_timer(stats != nullptr ? &stats->filter_ns : nullptr);
+        phrase_matches = FindPhraseMatches(query_words);
+    }
+
+    std::pmr::vector<Document> result(query_words.GetResource());
+    result.reserve(relevances.size());
+
+    for (const auto& [internal_id, relevance] : relevances) {
+        if (phrase_matches && !std::binary_search(phrase_matches->begin(), phrase_matches->end(), internal_id)) {
+            continue;
+        }
+        result.push_back({external_ids_[internal_id], relevance, ratings_[internal_id]});
+    }
 
-    for (const auto& [document_id, relevance] : IDF_TF.BuildOrdinaryMap()) {
-        result.push_back({document_id, relevance, document_info_.at(document_id).rating});
+    if (stats != nullptr) {
+        stats->postings_scanned = postings_scanned;
+        stats->documents_scored = documents_scored;
+        stats->rejected_by_filter = rejected_by_filter;
+        stats->rejected_by_minus_words = documents_scored - relevances.size();
     }
 
     return result;
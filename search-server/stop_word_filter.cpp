@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <numeric>
+
+#include "stop_word_filter.h"
+
+namespace {
+
+// сколько seed перебирать для одной корзины, прежде чем взять больше корзин и слотов
+constexpr uint32_t MAX_SEED = 1 << 16;
+
+// слотов на слово; при 0.85 слова на слот свободна примерно каждая седьмая ячейка, и seed находится быстро
+constexpr double SLOTS_PER_WORD = 1.0 / 0.85;
+
+} // namespace
+
+size_t StopWordFilter::GetWordCount() const {
+    return word_count_;
+}
+
+void StopWordFilter::Build(std::vector<std::string_view> words) {
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    if (words.empty()) {
+        return;
+    }
+
+    for (std::string_view word : words) {
+        length_mask_ |= LengthBit(word.size());
+        const auto first_char = static_cast<unsigned char>(word[0]);
+        first_chars_[first_char / 64] |= uint64_t{1} << (first_char % 64);
+    }
+
+    word_count_ = words.size();
+
+    // в среднем два слова на корзину; если корзине не нашлось seed, корзин становится вдвое больше, а слотов --
+    // на восьмую часть: корзины мельчают, свободных слотов прибавляется, и очередная попытка почти наверняка удается
+    size_t slot_count = static_cast<size_t>(words.size() * SLOTS_PER_WORD) + 1;
+    for (size_t bucket_count = std::max<size_t>(1, words.size() / 2);; bucket_count *= 2, slot_count += slot_count / 8 + 1) {
+        // GetSlot берет размер таблицы из word_offsets_, поэтому он задается до подбора seed
+        word_offsets_.assign(slot_count + 1, 0);
+        if (TryBuild(words, bucket_count)) {
+            break;
+        }
+    }
+}
+
+bool StopWordFilter::TryBuild(const std::vector<std::string_view>& words, size_t bucket_count) {
+    std::vector<std::vector<uint32_t>> buckets(bucket_count);
+    std::vector<uint64_t> hashes(words.size());
+    for (uint32_t i = 0; i < words.size(); ++i) {
+        hashes[i] = Hash(words[i]);
+        buckets[hashes[i] % bucket_count].push_back(i);
+    }
+
+    // сначала самые полные корзины: пока таблица пуста, им проще найти свободные слоты
+    std::vector<uint32_t> bucket_order(bucket_count);
+    std::iota(bucket_order.begin(), bucket_order.end(), 0);
+    std::stable_sort(bucket_order.begin(), bucket_order.end(),
+                     [&buckets](uint32_t lhs, uint32_t rhs) { return buckets[lhs].size() > buckets[rhs].size(); });
+
+    seeds_.assign(bucket_count, 0);
+    std::vector<int> slot_words(GetSlotCount(), -1);
+    std::vector<size_t> slots;
+
+    for (const uint32_t bucket : bucket_order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+
+        bool is_placed = false;
+        for (uint32_t seed = 0; seed < MAX_SEED && !is_placed; ++seed) {
+            slots.clear();
+            is_placed = true;
+            for (const uint32_t word : buckets[bucket]) {
+                const size_t slot = GetSlot(hashes[word], seed);
+                if (slot_words[slot] >= 0 || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    is_placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (is_placed) {
+                seeds_[bucket] = seed;
+            }
+        }
+        if (!is_placed) {
+            return false;
+        }
+
+        for (size_t i = 0; i < slots.size(); ++i) {
+            slot_words[slots[i]] = buckets[bucket][i];
+        }
+    }
+
+    chars_.clear();
+    for (size_t slot = 0; slot < slot_words.size(); ++slot) {
+        if (slot_words[slot] >= 0) {
+            chars_.append(words[slot_words[slot]]);
+        }
+        word_offsets_[slot + 1] = chars_.size();
+    }
+    return true;
+}
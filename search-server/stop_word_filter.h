@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемое множество стоп-слов с совершенной хеш-функцией: каждое слово -- в своем слоте таблицы,
+// поэтому проверка слова -- один хеш и одно сравнение строк. Слотов примерно на 15% больше, чем слов:
+// в совсем плотной таблице последним корзинам трудно найти свободные слоты, и на больших словарях seed не находится.
+// Хеш двухуровневый: хеш слова выбирает корзину, а seed корзины -- слот; seed подбирается при построении так,
+// чтобы слова не сталкивались. Большинство не стоп-слов отсекается еще до хеша -- по длине и первой букве.
+// Буквы слов лежат подряд в одной строке фильтра, исходные строки можно не хранить.
+class StopWordFilter {
+public:
+
+    StopWordFilter() = default;
+
+    // пустые слова и повторы не учитываются
+    template <typename StringContainer>
+    explicit StopWordFilter(const StringContainer& words);
+
+    size_t GetWordCount() const;
+
+    bool Contains(std::string_view word) const {
+        // пустое слово отсекается битом длины 0 -- он никогда не установлен
+        if ((length_mask_ & LengthBit(word.size())) == 0) {
+            return false;
+        }
+        const auto first_char = static_cast<unsigned char>(word[0]);
+        if (((first_chars_[first_char / 64] >> (first_char % 64)) & 1) == 0) {
+            return false;
+        }
+
+        const uint64_t hash = Hash(word);
+        return GetWord(GetSlot(hash, seeds_[hash % seeds_.size()])) == word;
+    }
+
+private:
+
+    static uint64_t LengthBit(size_t length) {
+        return uint64_t{1} << std::min<size_t>(length, 63);
+    }
+
+    // FNV-1a
+    static uint64_t Hash(std::string_view word) {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : word) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    size_t GetSlot(uint64_t hash, uint32_t seed) const {
+        // перемешивание из splitmix64: разные seed дают для одного слова независимые слоты
+        uint64_t mixed = hash + (seed + 1) * 0x9e3779b97f4a7c15ull;
+        mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ull;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebull;
+        return (mixed ^ (mixed >> 31)) % GetSlotCount();
+    }
+
+    size_t GetSlotCount() const {
+        return word_offsets_.empty() ? 0 : word_offsets_.size() - 1;
+    }
+
+    // у свободного слота слово пустое -- с непустым словом оно не совпадает
+    std::string_view GetWord(size_t slot) const {
+        return std::string_view(chars_).substr(word_offsets_[slot], word_offsets_[slot + 1] - word_offsets_[slot]);
+    }
+
+    void Build(std::vector<std::string_view> words);
+
+    // подбирает seed для bucket_count корзин; false -- какой-то корзине seed не нашелся
+    bool TryBuild(const std::vector<std::string_view>& words, size_t bucket_count);
+
+    size_t word_count_ = 0;
+    std::string chars_; // слова в порядке слотов
+    std::vector<uint32_t> word_offsets_; // слово слота -- chars_[word_offsets_[slot], word_offsets_[slot + 1])
+    std::vector<uint32_t> seeds_; // по корзинам
+    uint64_t length_mask_ = 0; // бит LengthBit каждой длины стоп-слова
+    std::array<uint64_t, 4> first_chars_{}; // битовая карта первых байтов стоп-слов
+};
+
+template <typename StringContainer>
+StopWordFilter::StopWordFilter(const StringContainer& words) {
+    std::vector<std::string_view> views;
+    for (std::string_view word : words) {
+        if (!word.empty()) {
+            views.push_back(word);
+        }
+    }
+    Build(std::move(views));
+}
@@ -23,17 +23,36 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str) {
     std::vector<std::string_view> result;
+    ForEachWord(str, [&result](std::string_view word) { result.push_back(word); });
 
-    str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
-    std::string_view word = str.substr(0, str.find_first_of(' '));
+    return result;
+}
 
+bool IsWildcardMatch(std::string_view word, std::string_view pattern) {
+    size_t word_pos = 0;
+    size_t pattern_pos = 0;
+    // где была последняя звездочка и с какого символа слова она начала поглощать -- для отката
+    size_t star_pos = std::string_view::npos;
+    size_t star_word_pos = 0;
+
+    while (word_pos < word.size()) {
+        if (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+            star_pos = pattern_pos++;
+            star_word_pos = word_pos;
+        } else if (pattern_pos < pattern.size() && pattern[pattern_pos] == word[word_pos]) {
+            ++pattern_pos;
+            ++word_pos;
+        } else if (star_pos != std::string_view::npos) {
+            pattern_pos = star_pos + 1;
+            word_pos = ++star_word_pos;
+        } else {
+            return false;
+        }
+    }
 
-    while (word.size()) {
-        result.push_back(word);
-        str.remove_prefix(word.size());
-        str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
-        word = str.substr(0, str.find_first_of(' '));
+    while (pattern_pos < pattern.size() && pattern[pattern_pos] == '*') {
+        ++pattern_pos;
     }
 
-    return result;
-}
\ No newline at end of file
+    return pattern_pos == pattern.size();
+}
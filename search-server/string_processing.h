@@ -2,21 +2,25 @@
 #include <vector>
 #include <string>
 #include <string_view>
-#include <set>
 #include <algorithm>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
 
-template <typename StringContainer>
-std::set<std::string_view> MakeSetStopWords(const StringContainer& words) {
-    std::set<std::string_view> stop_words;
-    for (std::string_view word : words) {
-        if (!word.empty()) {
-            stop_words.insert(word);
-        }
+// вызывает func для каждого слова str, не собирая их в вектор
+template <typename Func>
+void ForEachWord(std::string_view str, Func func) {
+    str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
+    std::string_view word = str.substr(0, str.find_first_of(' '));
+
+    while (word.size()) {
+        func(word);
+        str.remove_prefix(word.size());
+        str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
+        word = str.substr(0, str.find_first_of(' '));
     }
-    
-    return stop_words;
-}
\ No newline at end of file
+}
+
+// сопоставление слова с шаблоном, где '*' -- любая (в том числе пустая) последовательность символов
+bool IsWildcardMatch(std::string_view word, std::string_view pattern);
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "synonym_graph.h"
+
+using namespace std::literals;
+
+size_t SynonymGraph::GetWordCount() const {
+    return word_offsets_.empty() ? 0 : word_offsets_.size() - 1;
+}
+
+size_t SynonymGraph::GetSynonymCount(std::string_view word) const {
+    const int id = FindWordId(word);
+    return id < 0 ? 0 : offsets_[id + 1] - offsets_[id];
+}
+
+bool SynonymGraph::AreSynonyms(std::string_view lhs, std::string_view rhs) const {
+    const int lhs_id = FindWordId(lhs);
+    const int rhs_id = FindWordId(rhs);
+    if (lhs_id < 0 || rhs_id < 0) {
+        return false;
+    }
+    return std::binary_search(neighbors_.begin() + offsets_[lhs_id], neighbors_.begin() + offsets_[lhs_id + 1],
+                              static_cast<uint32_t>(rhs_id));
+}
+
+void SynonymGraph::Build(const std::vector<std::pair<std::string_view, std::string_view>>& pairs) {
+    std::vector<std::string_view> words;
+    words.reserve(pairs.size() * 2);
+    for (const auto& [lhs, rhs] : pairs) {
+        for (std::string_view word : {lhs, rhs}) {
+            if (word.empty() || word.find(' ') != std::string_view::npos) {
+                throw std::invalid_argument("Synonym must be a single non-empty word"s);
+            }
+            words.push_back(word);
+        }
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    word_offsets_.reserve(words.size() + 1);
+    word_offsets_.push_back(0);
+    for (std::string_view word : words) {
+        chars_.append(word);
+        word_offsets_.push_back(chars_.size());
+    }
+
+    auto get_id = [&words](std::string_view word) {
+        return static_cast<uint32_t>(std::lower_bound(words.begin(), words.end(), word) - words.begin());
+    };
+
+    // ребра в обе стороны, отсортированные по (откуда, куда) -- это и есть строки плоской таблицы смежности
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.reserve(pairs.size() * 2);
+    for (const auto& [lhs, rhs] : pairs) {
+        const uint32_t lhs_id = get_id(lhs);
+        const uint32_t rhs_id = get_id(rhs);
+        if (lhs_id != rhs_id) {
+            edges.emplace_back(lhs_id, rhs_id);
+            edges.emplace_back(rhs_id, lhs_id);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    offsets_.assign(words.size() + 1, 0);
+    neighbors_.reserve(edges.size());
+    for (const auto& [from, to] : edges) {
+        ++offsets_[from + 1];
+        neighbors_.push_back(to);
+    }
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+}
+
+int SynonymGraph::FindWordId(std::string_view word) const {
+    // слова упорядочены по id, поэтому ищем двоичным поиском прямо по хранилищу
+    size_t left = 0;
+    size_t right = GetWordCount();
+    while (left < right) {
+        const size_t middle = left + (right - left) / 2;
+        if (GetWord(middle) < word) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    return left < GetWordCount() && GetWord(left) == word ? static_cast<int>(left) : -1;
+}
+
+std::string_view SynonymGraph::GetWord(uint32_t id) const {
+    return std::string_view(chars_).substr(word_offsets_[id], word_offsets_[id + 1] - word_offsets_[id]);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Неизменяемый граф синонимов, загружаемый одной пачкой пар. Слова интернированы: у каждого плотный id
+// (номер в лексикографическом порядке), сами буквы лежат подряд в одной строке. Соседи хранятся
+// в плоских массивах: синонимы слова id -- neighbors_[offsets_[id], offsets_[id + 1]), по возрастанию id.
+class SynonymGraph {
+public:
+
+    SynonymGraph() = default;
+
+    // пары синонимов; отношение симметричное, повторы пар и пары слова с самим собой не учитываются
+    template <typename PairContainer>
+    explicit SynonymGraph(const PairContainer& pairs);
+
+    size_t GetWordCount() const;
+
+    // синонимов у слова, которого нет в графе, -- 0
+    size_t GetSynonymCount(std::string_view word) const;
+
+    bool AreSynonyms(std::string_view lhs, std::string_view rhs) const;
+
+    // вызывает func(std::string_view) для каждого синонима word; вью смотрят в хранилище графа
+    template <typename Func>
+    void ForEachSynonym(std::string_view word, Func func) const;
+
+private:
+
+    void Build(const std::vector<std::pair<std::string_view, std::string_view>>& pairs);
+
+    // -1, если слова в графе нет
+    int FindWordId(std::string_view word) const;
+
+    std::string_view GetWord(uint32_t id) const;
+
+    std::string chars_; // все слова подряд
+    std::vector<uint32_t> word_offsets_; // слово id -- chars_[word_offsets_[id], word_offsets_[id + 1])
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> neighbors_;
+};
+
+template <typename PairContainer>
+SynonymGraph::SynonymGraph(const PairContainer& pairs) {
+    std::vector<std::pair<std::string_view, std::string_view>> views;
+    for (const auto& [lhs, rhs] : pairs) {
+        views.emplace_back(lhs, rhs);
+    }
+    Build(views);
+}
+
+template <typename Func>
+void SynonymGraph::ForEachSynonym(std::string_view word, Func func) const {
+    const int id = FindWordId(word);
+    if (id < 0) {
+        return;
+    }
+    for (uint32_t i = offsets_[id]; i < offsets_[id + 1]; ++i) {
+        func(GetWord(neighbors_[i]));
+    }
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "term_dictionary.h"
+
+namespace {
+
+constexpr size_t NO_DELETION = static_cast<size_t>(-1);
+constexpr uint32_t DROPPED_TERM = static_cast<uint32_t>(-1);
+
+// FNV-1a строки, которая получается из word удалением символов first и second (NO_DELETION -- не удалять),
+// без сборки самой строки; коллизии безвредны -- каждого кандидата проверяет автомат
+uint32_t HashDeletion(std::string_view word, size_t first = NO_DELETION, size_t second = NO_DELETION) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (i != first && i != second) {
+            hash = (hash ^ static_cast<unsigned char>(word[i])) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+} // namespace
+
+TermDictionary::Segment::Segment(std::vector<std::string_view> sorted_terms)
+    : terms(std::move(sorted_terms)) {
+}
+
+TermDictionary::Segment::Segment(const Segment& lhs, const Segment* rhs, const TermFilter* is_live) {
+    const std::vector<std::string_view> no_terms;
+    const std::vector<std::string_view>& rhs_terms = rhs ? rhs->terms : no_terms;
+    terms.reserve(lhs.terms.size() + rhs_terms.size());
+
+    // новые номера слов обоих сегментов -- по ним переписываются записи индексов
+    std::vector<uint32_t> lhs_numbers(lhs.terms.size());
+    std::vector<uint32_t> rhs_numbers(rhs_terms.size());
+    size_t lhs_index = 0;
+    size_t rhs_index = 0;
+    while (lhs_index < lhs.terms.size() || rhs_index < rhs_terms.size()) {
+        // сегменты не пересекаются -- берем меньшее из двух очередных слов
+        const bool from_rhs = lhs_index == lhs.terms.size()
+                              || (rhs_index < rhs_terms.size() && rhs_terms[rhs_index] < lhs.terms[lhs_index]);
+        const std::string_view term = from_rhs ? rhs_terms[rhs_index] : lhs.terms[lhs_index];
+        uint32_t& number = from_rhs ? rhs_numbers[rhs_index++] : lhs_numbers[lhs_index++];
+        if (is_live && !(*is_live)(term)) {
+            number = DROPPED_TERM;
+        } else {
+            number = static_cast<uint32_t>(terms.size());
+            terms.push_back(term);
+        }
+    }
+
+    // индекса у lhs нет -- нечеткий поиск им еще не пользовался, и новый сегмент тоже построит его лениво
+    if (lhs.has_deletions.load(std::memory_order_acquire)) {
+        std::call_once(deletions_once, [&] { MergeDeletions(lhs, lhs_numbers, rhs, rhs_numbers, *this); });
+    }
+}
+
+TermDictionary::TermDictionary(std::vector<std::string_view> terms)
+    : base_(std::make_shared<const Segment>(std::move(terms))) {
+}
+
+TermDictionary::TermDictionary(std::shared_ptr<const Segment> base, std::shared_ptr<const Segment> delta, size_t removed_count)
+    : base_(std::move(base))
+    , delta_(std::move(delta))
+    , removed_count_(removed_count) {
+}
+
+std::shared_ptr<const TermDictionary> TermDictionary::Update(std::vector<std::string_view> added, size_t removed,
+                                                             const TermFilter& is_live) const {
+    size_t removed_count = removed_count_ + removed;
+    // вернувшееся слово еще лежит в сегменте -- оно просто снова живое
+    std::vector<std::string_view> new_terms;
+    new_terms.reserve(added.size());
+    for (const std::string_view term : added) {
+        if (Contains(term)) {
+            --removed_count;
+        } else {
+            new_terms.push_back(term);
+        }
+    }
+    std::sort(new_terms.begin(), new_terms.end());
+
+    // новые слова копируют только дельту, основной сегмент остается общим со старым снимком. Если нечеткий
+    // поиск уже строил индексы, удаления хешируются только у новых слов
+    std::shared_ptr<const Segment> delta = delta_;
+    if (!new_terms.empty()) {
+        const Segment added_segment(std::move(new_terms));
+        if (base_->has_deletions.load(std::memory_order_acquire)) {
+            std::call_once(added_segment.deletions_once, [&added_segment] { BuildDeletions(added_segment); });
+        }
+        delta = delta ? std::make_shared<const Segment>(*delta, &added_segment, nullptr)
+                      : std::make_shared<const Segment>(added_segment, nullptr, nullptr);
+    }
+
+    // дельта копируется каждым новым словом, а слияние с основным сегментом линейно по всему словарю; слияние,
+    // когда дельта перерастает корень из основного сегмента, держит обе цены около корня из словаря на слово.
+    // Пропавшие слова вычищает то же слияние -- когда их становится больше половины
+    const size_t delta_size = delta ? delta->terms.size() : 0;
+    const size_t term_count = base_->terms.size() + delta_size;
+    const bool is_delta_large = delta_size > MIN_MERGED_DELTA && delta_size * delta_size > base_->terms.size();
+    if (!is_delta_large && removed_count * 2 <= term_count) {
+        return std::shared_ptr<const TermDictionary>(new TermDictionary(base_, std::move(delta), removed_count));
+    }
+
+    auto base = std::make_shared<const Segment>(*base_, delta.get(), removed_count > 0 ? &is_live : nullptr);
+    return std::shared_ptr<const TermDictionary>(new TermDictionary(std::move(base), nullptr, 0));
+}
+
+size_t TermDictionary::Size() const {
+    return base_->terms.size() + (delta_ ? delta_->terms.size() : 0) - removed_count_;
+}
+
+bool TermDictionary::HasRemovedTerms() const {
+    return removed_count_ > 0;
+}
+
+size_t TermDictionary::MemoryUsage() const {
+    size_t memory = 0;
+    for (const Segment* segment : {base_.get(), delta_.get()}) {
+        if (segment) {
+            memory += segment->terms.capacity() * sizeof(std::string_view) + segment->deletions_memory.load(std::memory_order_acquire);
+        }
+    }
+    return memory;
+}
+
+bool TermDictionary::Contains(std::string_view term) const {
+    return std::binary_search(base_->terms.begin(), base_->terms.end(), term)
+           || (delta_ && std::binary_search(delta_->terms.begin(), delta_->terms.end(), term));
+}
+
+std::vector<std::string_view> TermDictionary::FindPrefix(std::string_view prefix, size_t max_terms, const TermFilter& filter) const {
+    const auto find_range = [prefix](const std::vector<std::string_view>& terms) {
+        const auto first = std::lower_bound(terms.begin(), terms.end(), prefix);
+        const auto last = std::partition_point(first, terms.end(),
+                                               [prefix](std::string_view term) { return term.substr(0, prefix.size()) == prefix; });
+        return std::make_pair(first, last);
+    };
+
+    auto [base_it, base_end] = find_range(base_->terms);
+    auto [delta_it, delta_end] = delta_ ? find_range(delta_->terms) : std::make_pair(base_end, base_end);
+
+    std::vector<std::string_view> terms;
+    while (terms.size() < max_terms && (base_it != base_end || delta_it != delta_end)) {
+        const bool from_delta = base_it == base_end || (delta_it != delta_end && *delta_it < *base_it);
+        const std::string_view term = from_delta ? *delta_it++ : *base_it++;
+        if (filter(term)) {
+            terms.push_back(term);
+        }
+    }
+
+    return terms;
+}
+
+std::vector<std::pair<int, std::string_view>> TermDictionary::FindFuzzy(const LevenshteinAutomaton& automaton) const {
+    std::vector<std::pair<int, std::string_view>> matches;
+    FindFuzzy(*base_, automaton, matches);
+    if (delta_) {
+        const size_t base_match_count = matches.size();
+        FindFuzzy(*delta_, automaton, matches);
+        std::inplace_merge(matches.begin(), matches.begin() + base_match_count, matches.end(),
+                           [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
+    }
+    return matches;
+}
+
+void TermDictionary::FindFuzzy(const Segment& segment, const LevenshteinAutomaton& automaton,
+                               std::vector<std::pair<int, std::string_view>>& matches) {
+    std::vector<int> states;
+    int distance = 0;
+
+    if (automaton.GetMaxDistance() > MAX_INDEXED_DISTANCE) {
+        for (const std::string_view term : segment.terms) {
+            if (Accepts(automaton, term, states, distance)) {
+                matches.emplace_back(distance, term);
+            }
+        }
+        return;
+    }
+
+    std::call_once(segment.deletions_once, [&segment] { BuildDeletions(segment); });
+
+    const int max_distance = automaton.GetMaxDistance();
+    std::vector<std::pair<uint32_t, int>> hashes;
+    CollectDeletionHashes(automaton.GetWord(), max_distance, hashes);
+
+    // для расстояния d из слова словаря достаточно удалить не больше d символов
+    std::vector<uint32_t> candidates;
+    candidates.reserve(4 * hashes.size());
+    for (const auto& [hash, deleted] : hashes) {
+        const uint32_t bucket = segment.bucket_bits == 0 ? 0 : hash >> (32 - segment.bucket_bits);
+        const auto bucket_end = segment.deletions.begin() + segment.bucket_starts[bucket + 1];
+        for (auto it = segment.deletions.begin() + segment.bucket_starts[bucket]; it != bucket_end; ++it) {
+            if (it->hash == hash && static_cast<int>(it->deleted) <= max_distance) {
+                candidates.push_back(it->term);
+            }
+        }
+    }
+    // номера слов по возрастанию -- совпадения выйдут в порядке словаря
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (const uint32_t candidate : candidates) {
+        if (Accepts(automaton, segment.terms[candidate], states, distance)) {
+            matches.emplace_back(distance, segment.terms[candidate]);
+        }
+    }
+}
+
+void TermDictionary::CollectDeletionHashes(std::string_view word, int max_deletions, std::vector<std::pair<uint32_t, int>>& hashes) {
+    hashes.clear();
+    hashes.reserve(1 + word.size() + (max_deletions >= 2 ? word.size() * (word.size() - 1) / 2 : 0));
+    hashes.emplace_back(HashDeletion(word), 0);
+
+    // удаляем символ first, а если можно -- еще и символ second после него
+    for (size_t first = 0; first < word.size() && max_deletions >= 1; ++first) {
+        hashes.emplace_back(HashDeletion(word, first), 1);
+        for (size_t second = first + 1; second < word.size() && max_deletions >= 2; ++second) {
+            hashes.emplace_back(HashDeletion(word, first, second), 2);
+        }
+    }
+
+    // удаления из серии одинаковых символов дают одну и ту же строку; после сортировки первым идет
+    // вариант с наименьшим числом удалений, его и оставляем
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end(),
+                             [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }),
+                 hashes.end());
+}
+
+void TermDictionary::BuildDeletions(const Segment& segment) {
+    std::vector<std::pair<uint32_t, int>> hashes;
+    for (uint32_t term = 0; term < segment.terms.size(); ++term) {
+        CollectDeletionHashes(segment.terms[term], MAX_INDEXED_DISTANCE, hashes);
+        for (const auto& [hash, deleted] : hashes) {
+            segment.deletions.push_back({hash, term, static_cast<uint32_t>(deleted)});
+        }
+    }
+    std::sort(segment.deletions.begin(), segment.deletions.end());
+    FinishDeletions(segment);
+}
+
+void TermDictionary::MergeDeletions(const Segment& lhs, const std::vector<uint32_t>& lhs_terms, const Segment* rhs,
+                                    const std::vector<uint32_t>& rhs_terms, const Segment& merged) {
+    // индекс rhs маленький (новые слова или дельта) -- если его еще нет, строим
+    std::vector<Deletion> rhs_deletions;
+    if (rhs) {
+        std::call_once(rhs->deletions_once, [rhs] { BuildDeletions(*rhs); });
+        rhs_deletions.reserve(rhs->deletions.size());
+        for (const Deletion& deletion : rhs->deletions) {
+            if (rhs_terms[deletion.term] != DROPPED_TERM) {
+                rhs_deletions.push_back({deletion.hash, rhs_terms[deletion.term], deletion.deleted});
+            }
+        }
+    }
+
+    // перенумерация сохраняет порядок слов внутри сегмента, поэтому оба индекса остаются отсортированными,
+    // и их достаточно слить
+    merged.deletions.reserve(lhs.deletions.size() + rhs_deletions.size());
+    auto rhs_it = rhs_deletions.begin();
+    for (const Deletion& deletion : lhs.deletions) {
+        if (lhs_terms[deletion.term] == DROPPED_TERM) {
+            continue;
+        }
+        const Deletion renumbered{deletion.hash, lhs_terms[deletion.term], deletion.deleted};
+        while (rhs_it != rhs_deletions.end() && *rhs_it < renumbered) {
+            merged.deletions.push_back(*rhs_it++);
+        }
+        merged.deletions.push_back(renumbered);
+    }
+    merged.deletions.insert(merged.deletions.end(), rhs_it, rhs_deletions.end());
+    FinishDeletions(merged);
+}
+
+void TermDictionary::FinishDeletions(const Segment& segment) {
+    segment.deletions.shrink_to_fit();
+
+    // корзин примерно столько же, сколько записей: поиск хеша -- переход в корзину и просмотр пары записей
+    while (segment.bucket_bits < 31 && (size_t{1} << segment.bucket_bits) < segment.deletions.size()) {
+        ++segment.bucket_bits;
+    }
+    segment.bucket_starts.assign((size_t{1} << segment.bucket_bits) + 1, 0);
+    size_t index = 0;
+    for (size_t bucket = 0; bucket < segment.bucket_starts.size(); ++bucket) {
+        while (index < segment.deletions.size() && segment.bucket_bits != 0
+               && (segment.deletions[index].hash >> (32 - segment.bucket_bits)) < bucket) {
+            ++index;
+        }
+        segment.bucket_starts[bucket] = bucket + 1 == segment.bucket_starts.size() ? segment.deletions.size() : index;
+    }
+
+    segment.deletions_memory.store(segment.deletions.capacity() * sizeof(Deletion) + segment.bucket_starts.capacity() * sizeof(uint32_t),
+                                   std::memory_order_release);
+    segment.has_deletions.store(true, std::memory_order_release);
+}
+
+bool TermDictionary::Accepts(const LevenshteinAutomaton& automaton, std::string_view term, std::vector<int>& states, int& distance) {
+    // у слов, которые длиннее или короче больше чем на max_distance, расстояние заведомо больше
+    const int length_difference = static_cast<int>(term.size()) - static_cast<int>(automaton.GetWord().size());
+    if (std::abs(length_difference) > automaton.GetMaxDistance()) {
+        return false;
+    }
+
+    // две полосы попеременно: текущая и следующая
+    const size_t state_size = automaton.GetStateSize();
+    states.resize(2 * state_size);
+    int* state = states.data();
+    int* next = states.data() + state_size;
+    automaton.Start(state);
+    for (size_t depth = 0; depth < term.size(); ++depth) {
+        automaton.Step(state, depth, term[depth], next);
+        std::swap(state, next);
+        if (!automaton.CanMatch(state)) {
+            return false;
+        }
+    }
+
+    if (!automaton.IsMatch(state, term.size())) {
+        return false;
+    }
+    distance = automaton.GetDistance(state, term.size());
+    return true;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "levenshtein_automaton.h"
+
+// Упорядоченный словарь -- неизменяемый снимок из двух отсортированных сегментов: большого основного и маленькой
+// дельты со словами, добавленными после его сборки. Новое слово копирует только дельту, а когда дельта вырастает
+// больше корня из размера основного сегмента, они сливаются одним линейным проходом. Пропавшие слова остаются
+// в снимке до слияния, и отсеивает их тот, кто спрашивает: снимок знает только, сколько их.
+// Префиксный поиск -- двоичный поиск в обоих сегментах. Для нечеткого поиска при первом запросе в сегменте строится
+// индекс удалений: для каждого слова хешируются все строки, которые получаются из него удалением не больше
+// MAX_INDEXED_DISTANCE символов. Если расстояние между словами не больше d, то из каждого можно удалить не больше d
+// символов так, что останется одна и та же строка, поэтому кандидаты для слова запроса -- слова с общим хешем
+// удалений, и автомат проверяет только их, а не весь словарь. Когда индекс уже есть, новые сегменты наследуют его:
+// хешируются только новые слова, а индексы сегментов при слиянии сливаются так же, как сами слова.
+class TermDictionary {
+public:
+
+    // до какого расстояния FindFuzzy ищет по индексу удалений; дальше -- проверяет автоматом весь словарь
+    static constexpr int MAX_INDEXED_DISTANCE = 2;
+    // дельта меньше этого не сливается с основным сегментом, каким бы маленьким он ни был
+    static constexpr size_t MIN_MERGED_DELTA = 64;
+
+    using TermFilter = std::function<bool(std::string_view)>;
+
+    // terms -- слова по возрастанию, без повторов; строки должны пережить словарь
+    explicit TermDictionary(std::vector<std::string_view> terms);
+
+    // снимок, в котором появились слова added (в любом порядке; среди них нет живых слов словаря) и пропали
+    // removed живых слов. Старый снимок не меняется -- его могут держать параллельные запросы.
+    // При слиянии сегментов слова, которые не пропускает is_live, выбрасываются
+    std::shared_ptr<const TermDictionary> Update(std::vector<std::string_view> added, size_t removed, const TermFilter& is_live) const;
+
+    // живых слов
+    size_t Size() const;
+
+    // есть ли в снимке пропавшие слова, которые надо отсеивать
+    bool HasRemovedTerms() const;
+
+    // байт в куче
+    size_t MemoryUsage() const;
+
+    // не больше max_terms слов, начинающихся с prefix и пропущенных filter, по возрастанию
+    std::vector<std::string_view> FindPrefix(std::string_view prefix, size_t max_terms, const TermFilter& filter) const;
+
+    // все слова, которые принимает автомат: пары [расстояние -- слово] в порядке словаря
+    std::vector<std::pair<int, std::string_view>> FindFuzzy(const LevenshteinAutomaton& automaton) const;
+
+private:
+
+    struct Deletion {
+        uint32_t hash;
+        uint32_t term : 30;    // номер слова в сегменте
+        uint32_t deleted : 2;  // сколько символов удалено из слова
+
+        bool operator<(const Deletion& other) const {
+            return hash < other.hash || (hash == other.hash && term < other.term);
+        }
+    };
+
+    // отсортированные слова и их индекс удалений; сегмент делят между собой снимки, поэтому индекс
+    // строится один раз под deletions_once
+    struct Segment {
+        explicit Segment(std::vector<std::string_view> sorted_terms);
+
+        // слияние сегментов без общих слов; слова, которые не пропускает is_live (если он есть), выбрасываются.
+        // Если у lhs индекс удалений уже построен, индекс слияния собирается из индексов обоих сегментов
+        // линейным проходом -- без хеширования и сортировки слов lhs
+        Segment(const Segment& lhs, const Segment* rhs, const TermFilter* is_live);
+
+        std::vector<std::string_view> terms;
+        mutable std::once_flag deletions_once;
+        mutable std::atomic<bool> has_deletions{false};
+        mutable std::vector<Deletion> deletions; // по возрастанию хеша
+        // deletions с хешем, у которого старшие bucket_bits бит равны b, -- [bucket_starts[b], bucket_starts[b + 1])
+        mutable std::vector<uint32_t> bucket_starts;
+        mutable int bucket_bits = 0;
+        mutable std::atomic<size_t> deletions_memory{0};
+    };
+
+    TermDictionary(std::shared_ptr<const Segment> base, std::shared_ptr<const Segment> delta, size_t removed_count);
+
+    // хеши всех строк, которые получаются из word удалением не больше max_deletions символов, с числом удаленных
+    // символов (у повторяющейся строки -- наименьшим), без повторов
+    static void CollectDeletionHashes(std::string_view word, int max_deletions, std::vector<std::pair<uint32_t, int>>& hashes);
+
+    static void BuildDeletions(const Segment& segment);
+
+    // слияние индексов lhs и rhs при новых номерах слов lhs_terms и rhs_terms (DROPPED_TERM -- слово выброшено)
+    static void MergeDeletions(const Segment& lhs, const std::vector<uint32_t>& lhs_terms, const Segment* rhs,
+                               const std::vector<uint32_t>& rhs_terms, const Segment& merged);
+
+    // корзины и учет памяти для уже отсортированного индекса
+    static void FinishDeletions(const Segment& segment);
+
+    static void FindFuzzy(const Segment& segment, const LevenshteinAutomaton& automaton,
+                          std::vector<std::pair<int, std::string_view>>& matches);
+
+    // есть ли term в снимке, живое оно или пропавшее
+    bool Contains(std::string_view term) const;
+
+    // расстояние до слова, если автомат его принимает
+    static bool Accepts(const LevenshteinAutomaton& automaton, std::string_view term, std::vector<int>& states, int& distance);
+
+    std::shared_ptr<const Segment> base_;
+    std::shared_ptr<const Segment> delta_; // пусто -- слов после сборки основного сегмента не добавлялось
+    size_t removed_count_ = 0; // пропавших слов, которые еще лежат в сегментах
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Словарь слово -- Value с открытой адресацией: слоты лежат одним массивом, коллизии разрешаются линейным
+// пробированием, удаление сдвигает хвост цепочки назад (без надгробий). Хеш слова хранится в слоте: при
+// пробировании строки сравниваются только при совпадении хешей, а рост таблицы не пересчитывает хеши.
+// Ключи -- вью, строки должны пережить словарь. Порядка слов нет; упорядоченный обход -- через снимок
+// отсортированных слов (TermDictionary).
+// Value -- контейнер с аллокатором (allocator_type): и слоты, и значения выделяются его аллокатором.
+// Указатели на значения действительны до следующей вставки или удаления.
+template <typename Value>
+class TermHashMap {
+public:
+    using Allocator = typename Value::allocator_type;
+
+    explicit TermHashMap(const Allocator& allocator = Allocator())
+        : value_allocator_(allocator)
+        , slots_(SlotAllocator(allocator)) {
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    // nullptr -- слова нет
+    Value* Find(std::string_view word) {
+        const size_t index = FindIndex(word, Hash(word));
+        return index == NOT_FOUND ? nullptr : &slots_[index].value;
+    }
+
+    const Value* Find(std::string_view word) const {
+        const size_t index = FindIndex(word, Hash(word));
+        return index == NOT_FOUND ? nullptr : &slots_[index].value;
+    }
+
+    // значение слова; если слова нет, вставляет пустое
+    Value& operator[](std::string_view word) {
+        const uint64_t hash = Hash(word);
+        const size_t index = FindIndex(word, hash);
+        if (index != NOT_FOUND) {
+            return slots_[index].value;
+        }
+
+        // загрузка не больше 3/4: дальше цепочки линейного пробирования быстро длинеют
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            Rehash(std::max<size_t>(MIN_CAPACITY, slots_.size() * 2));
+        }
+
+        const size_t mask = slots_.size() - 1;
+        size_t free_index = hash & mask;
+        while (!slots_[free_index].key.empty()) {
+            free_index = (free_index + 1) & mask;
+        }
+        slots_[free_index].hash = hash;
+        slots_[free_index].key = word;
+        ++size_;
+        return slots_[free_index].value;
+    }
+
+    // сколько слов удалено: 0 или 1
+    size_t Erase(std::string_view word) {
+        size_t hole = FindIndex(word, Hash(word));
+        if (hole == NOT_FOUND) {
+            return 0;
+        }
+
+        // слот из цепочки за дырой переезжает в нее, если дыра не раньше его домашнего слота по ходу пробирования
+        const size_t mask = slots_.size() - 1;
+        for (size_t next = (hole + 1) & mask; !slots_[next].key.empty(); next = (next + 1) & mask) {
+            const size_t home = slots_[next].hash & mask;
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots_[hole].hash = slots_[next].hash;
+                slots_[hole].key = slots_[next].key;
+                slots_[hole].value = std::move(slots_[next].value);
+                hole = next;
+            }
+        }
+
+        slots_[hole].key = {};
+        slots_[hole].value.clear();
+        --size_;
+        return 1;
+    }
+
+    // освобождает и значения, и массив слотов
+    void Clear() {
+        SlotVector(slots_.get_allocator()).swap(slots_);
+        size_ = 0;
+    }
+
+    // вызывает func(std::string_view слово, const Value&) для каждого слова в порядке слотов
+    template <typename Func>
+    void ForEach(Func func) const {
+        for (const Slot& slot : slots_) {
+            if (!slot.key.empty()) {
+                func(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+
+    struct Slot {
+        uint64_t hash = 0;
+        std::string_view key; // пустой -- слот свободен
+        Value value;
+    };
+
+    using SlotAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+    using SlotVector = std::vector<Slot, SlotAllocator>;
+
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    static uint64_t Hash(std::string_view word) {
+        return std::hash<std::string_view>{}(word);
+    }
+
+    size_t FindIndex(std::string_view word, uint64_t hash) const {
+        if (slots_.empty()) {
+            return NOT_FOUND;
+        }
+
+        const size_t mask = slots_.size() - 1;
+        for (size_t index = hash & mask; !slots_[index].key.empty(); index = (index + 1) & mask) {
+            if (slots_[index].hash == hash && slots_[index].key == word) {
+                return index;
+            }
+        }
+        return NOT_FOUND;
+    }
+
+    void Rehash(size_t capacity) {
+        // пустые значения в новых слотах -- копии пустого прототипа с аллокатором словаря
+        SlotVector slots(capacity, Slot{0, {}, Value(value_allocator_)}, slots_.get_allocator());
+        const size_t mask = capacity - 1;
+        for (Slot& slot : slots_) {
+            if (slot.key.empty()) {
+                continue;
+            }
+            size_t index = slot.hash & mask;
+            while (!slots[index].key.empty()) {
+                index = (index + 1) & mask;
+            }
+            slots[index].hash = slot.hash;
+            slots[index].key = slot.key;
+            // аллокаторы равны -- узлы значения переезжают без копирования
+            slots[index].value = std::move(slot.value);
+        }
+        slots_.swap(slots);
+    }
+
+    Allocator value_allocator_;
+    SlotVector slots_;
+    size_t size_ = 0;
+};
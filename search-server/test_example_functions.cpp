@@ -1,6 +1,18 @@
 #include "document.h"
 #include "test_example_functions.h"
+#include <future>
+#include <list>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <set>
 #include <stdexcept>
+#include <thread>
+#include "paginator.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 using namespace std::string_literals;
 using namespace std::string_view_literals;
@@ -214,6 +226,61 @@ void TestGivenStatusAsFilter() {
     }
 }
 
+void TestStatusFilterAfterRemove() {
+    {
+        SearchServer search_server("and with"sv);
+        search_server.AddDocument(100, "funny pet and nasty rat"sv, DocumentStatus::BANNED, {7, 2, 7});
+        search_server.AddDocument(7, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, {1, 2});
+        search_server.AddDocument(50, "funny cat with curly tail"sv, DocumentStatus::BANNED, {5});
+
+        ASSERT_EQUAL(search_server.FindTopDocuments("funny"sv, DocumentStatus::BANNED).size(), 2u);
+
+        search_server.RemoveDocument(100);
+
+        const std::vector<Document> answer = search_server.FindTopDocuments("funny"sv, DocumentStatus::BANNED);
+        ASSERT_EQUAL(answer.size(), 1u);
+        ASSERT_EQUAL(answer[0].id, 50);
+        ASSERT_EQUAL(answer[0].rating, 5);
+        ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "funny"sv, DocumentStatus::BANNED).size(), 1u);
+        ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "funny"sv).size(), 1u);
+        ASSERT(search_server.FindTopDocuments("nasty rat"sv, DocumentStatus::BANNED).empty());
+    }
+}
+
+void TestDocumentFilterExpression() {
+    {
+        SearchServer search_server("and with"sv);
+        search_server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {7, 2, 7});
+        search_server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::BANNED, {1, 2, 3});
+        search_server.AddDocument(3, "funny cat nasty hair"sv, DocumentStatus::IRRELEVANT, {1, 2, 8});
+        search_server.AddDocument(4, "funny dog cat Vladislav"sv, DocumentStatus::ACTUAL, {1, 3, 2});
+
+        auto ids = [](const std::vector<Document>& documents) {
+            std::set<int> result;
+            for (const Document& document : documents) {
+                result.insert(document.id);
+            }
+            return result;
+        };
+
+        const std::set<int> actual_or_banned = {1, 2, 4};
+        ASSERT_EQUAL(ids(search_server.FindTopDocuments("funny"sv, StatusIn({DocumentStatus::ACTUAL, DocumentStatus::BANNED}))), actual_or_banned);
+
+        const std::set<int> rating_from_3 = {1, 3};
+        ASSERT_EQUAL(ids(search_server.FindTopDocuments("funny"sv, RatingBetween(3, 100))), rating_from_3);
+
+        const std::set<int> actual_with_small_id = {1};
+        ASSERT_EQUAL(ids(search_server.FindTopDocuments(std::execution::par, "funny"sv, StatusIn({DocumentStatus::ACTUAL}) && IdBetween(0, 3))), actual_with_small_id);
+
+        auto is_even = [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; };
+        const std::set<int> even_with_small_rating = {2, 4};
+        ASSERT_EQUAL(ids(search_server.FindTopDocuments("funny"sv, Where(is_even) && RatingBetween(0, 2))), even_with_small_rating);
+
+        ASSERT(search_server.FindTopDocuments("funny"sv, StatusIn({DocumentStatus::REMOVED})).empty());
+        ASSERT(search_server.FindTopDocuments("funny"sv, RatingBetween(5, 1)).empty());
+    }
+}
+
 void TestIsCorrectRelevance() {
     const int id1 = 3;
     std::string_view content1 = "spider man and doctor stiven strange with hulk"sv;
@@ -259,7 +326,7 @@ void TestGetWordFrequencies() {
         std::vector<int> rating = {7, 2, 7};
 
         search_server.AddDocument(id, content, status, rating);
-        std::map<std::string_view, double> word_freqs_at_document = {
+        WordFrequencies word_freqs_at_document = {
             {"funny"sv, 0.25},
             {"nasty"sv, 0.25},
             {"pet"sv, 0.25},
@@ -269,7 +336,7 @@ void TestGetWordFrequencies() {
         ASSERT_EQUAL(search_server.GetWordFrequencies(id), word_freqs_at_document);
 
         int non_existent_document_id = 1;
-        std::map<std::string_view, double> empty_map{};
+        WordFrequencies empty_map{};
         ASSERT_EQUAL(search_server.GetWordFrequencies(non_existent_document_id), empty_map);
     }
 }
@@ -308,11 +375,1659 @@ void TestRemoveDuplicates() {
     }
 }
 
+void TestRemoveNearDuplicates() {
+    {
+        SearchServer search_server("and with"sv);
+        search_server.AddDocument(1, "funny pet and nasty rat with curly hair"sv, DocumentStatus::ACTUAL, {7, 2, 7});
+        // отличается от документа 1 одним словом -- почти-дубликат
+        search_server.AddDocument(2, "funny pet and nasty rat with curly tail"sv, DocumentStatus::ACTUAL, {1, 2});
+        // тот же набор слов -- точный дубликат документа 1
+        search_server.AddDocument(3, "curly hair funny funny pet nasty rat"sv, DocumentStatus::ACTUAL, {1, 2});
+        // общих слов мало -- не дубликат
+        search_server.AddDocument(4, "big dog with curly hair"sv, DocumentStatus::ACTUAL, {1, 2});
+
+        const std::vector<std::vector<int>> expected_clusters = {{1, 2, 3}};
+        ASSERT(FindNearDuplicates(search_server, 0.7) == expected_clusters);
+        ASSERT_EQUAL_HINT(FindNearDuplicates(search_server, 1.0).size(), 1u, "Only exact duplicates should remain"sv);
+
+        RemoveNearDuplicates(search_server, 0.7);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+        ASSERT_EQUAL(search_server.FindTopDocuments("tail"sv).size(), 0u);
+    }
+    {
+        // 2 похож на 1 и 3 похож на 2 (9/11), но 3 на 1 -- нет (8/12): по цепочке в группу 1 он не попадает
+        SearchServer search_server("and with"sv);
+        search_server.AddDocument(1, "w1 w2 w3 w4 w5 w6 w7 w8 w9 w10"sv, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(2, "w2 w3 w4 w5 w6 w7 w8 w9 w10 w11"sv, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(3, "w3 w4 w5 w6 w7 w8 w9 w10 w11 w12"sv, DocumentStatus::ACTUAL, {1});
+        // документы из одних стоп-слов не дубликаты друг друга
+        search_server.AddDocument(4, "and with"sv, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(5, "with and with"sv, DocumentStatus::ACTUAL, {1});
+
+        const std::vector<std::vector<int>> expected_clusters = {{1, 2}};
+        ASSERT(FindNearDuplicates(search_server, 0.7) == expected_clusters);
+    }
+}
+
+void TestLatencyHistogram() {
+    for (uint64_t value : {0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456ull, 987654321ull}) {
+        const int index = LatencyHistogram::GetBucketIndex(value);
+        const uint64_t lower_bound = LatencyHistogram::GetBucketLowerBound(index);
+        ASSERT(lower_bound <= value);
+        ASSERT_HINT(value - lower_bound <= value / LatencyHistogram::SUB_BUCKET_COUNT, "Relative error should be below 1/32"sv);
+        ASSERT(LatencyHistogram::GetBucketLowerBound(index + 1) > value);
+    }
+    ASSERT_EQUAL(LatencyHistogram::GetBucketIndex(UINT64_MAX), LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+void TestTraceSnapshot() {
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, {1, 2});
+
+    SetTracingEnabled(true);
+    ResetTraces();
+
+    const int query_count = 100;
+    for (int i = 0; i < query_count; ++i) {
+        search_server.FindTopDocuments("funny -curly"sv);
+    }
+    search_server.MatchDocument("nasty rat"sv, 1);
+
+    SetTracingEnabled(false);
+    search_server.FindTopDocuments("funny"sv);
+
+    for (const SpanStats& stats : GetTraceSnapshot()) {
+        if (stats.name == "find_top_documents"sv || stats.name == "score"sv || stats.name == "filter"sv || stats.name == "sort"sv) {
+            ASSERT_EQUAL(stats.count, static_cast<uint64_t>(query_count));
+        } else if (stats.name == "parse"sv) {
+            ASSERT_EQUAL(stats.count, static_cast<uint64_t>(query_count + 1));
+        } else if (stats.name == "match_document"sv) {
+            ASSERT_EQUAL(stats.count, 1u);
+        }
+        ASSERT(stats.p50_ns <= stats.p99_ns && stats.p99_ns <= stats.p999_ns && stats.p999_ns <= stats.max_ns);
+    }
+
+    // гистограммы завершившихся потоков сливаются в общий итог -- их записи остаются в снимке
+    ResetTraces();
+    SetTracingEnabled(true);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&search_server] { search_server.FindTopDocuments("funny"sv); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    SetTracingEnabled(false);
+    for (const SpanStats& stats : GetTraceSnapshot()) {
+        if (stats.name == "find_top_documents"sv) {
+            ASSERT_EQUAL(stats.count, 4u);
+        }
+    }
+
+    ResetTraces();
+}
+
+void TestQueryStats() {
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"sv, DocumentStatus::ACTUAL, {1, 2});
+    search_server.AddDocument(3, "funny cat with curly tail"sv, DocumentStatus::BANNED, {5});
+    search_server.AddDocument(4, "nasty dog"sv, DocumentStatus::ACTUAL, {5});
+
+    {
+        QueryStats stats;
+        search_server.FindTopDocuments("funny nasty unknown -curly -absent"sv, DocumentStatus::ACTUAL, &stats);
+        ASSERT_EQUAL(stats.plus_words, 3);
+        ASSERT_EQUAL(stats.plus_words_resolved, 2);
+        ASSERT_EQUAL(stats.minus_words, 2);
+        ASSERT_EQUAL(stats.minus_words_resolved, 1);
+        ASSERT_EQUAL(stats.postings_scanned, 5u); // funny -- 3 документа, nasty -- 2
+        ASSERT_EQUAL(stats.rejected_by_filter, 1u); // документ 3 забанен
+        ASSERT_EQUAL(stats.documents_scored, 3u);
+        ASSERT_EQUAL(stats.rejected_by_minus_words, 1u); // документ 2
+        ASSERT_EQUAL(stats.candidates_sorted, 2u);
+        ASSERT(stats.total_ns >= stats.parse_ns + stats.score_ns + stats.filter_ns + stats.sort_ns);
+    }
+
+    {
+        QueryStats stats;
+        search_server.FindTopDocuments(std::execution::par, "funny nasty unknown -curly -absent"sv, DocumentStatus::ACTUAL, &stats);
+        ASSERT_EQUAL(stats.postings_scanned, 5u);
+        ASSERT_EQUAL(stats.rejected_by_filter, 1u);
+        ASSERT_EQUAL(stats.documents_scored, 3u);
+        ASSERT_EQUAL(stats.rejected_by_minus_words, 1u);
+        ASSERT_EQUAL(stats.candidates_sorted, 2u);
+    }
+
+    {
+        QueryStats stats;
+        search_server.MatchDocument("funny pet -curly"sv, 2, &stats);
+        ASSERT_EQUAL(stats.plus_words_resolved, 2);
+        ASSERT_EQUAL(stats.rejected_by_minus_words, 1u);
+
+        search_server.MatchDocument(std::execution::par, "funny pet -curly"sv, 1, &stats);
+        ASSERT_EQUAL(stats.plus_words_resolved, 2);
+        ASSERT_EQUAL(stats.rejected_by_minus_words, 0u);
+    }
+}
+
+void TestSearchAfterCursor() {
+    SearchServer search_server("and with"sv);
+    // у документов 1, 2, 3 одинаковые релевантность и рейтинг -- порядок между ними задает id
+    search_server.AddDocument(3, "cat city"sv, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(1, "cat city"sv, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(2, "cat city"sv, DocumentStatus::ACTUAL, {5});
+    search_server.AddDocument(4, "cat"sv, DocumentStatus::ACTUAL, {9});
+    search_server.AddDocument(5, "cat dog"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(6, "cat"sv, DocumentStatus::BANNED, {1});
+    search_server.AddDocument(7, "dog"sv, DocumentStatus::ACTUAL, {1});
+
+    std::vector<int> paged_ids;
+    std::optional<SearchCursor> cursor;
+    int page_count = 0;
+    do {
+        const SearchPage page = search_server.FindTopDocumentsAfter("cat city"sv, cursor, 2);
+        ASSERT(page.documents.size() <= 2u);
+        for (const Document& document : page.documents) {
+            paged_ids.push_back(document.id);
+        }
+        cursor = page.next_cursor;
+        ++page_count;
+    } while (cursor);
+
+    ASSERT_EQUAL(page_count, 3);
+    ASSERT(paged_ids == std::vector<int>({1, 2, 3, 4, 5}));
+
+    // страница, начатая с курсора из середины выдачи, совпадает с хвостом полной выдачи
+    const SearchPage full = search_server.FindTopDocumentsAfter("cat city"sv, std::nullopt, 10);
+    ASSERT(!full.next_cursor);
+    const SearchPage tail = search_server.FindTopDocumentsAfter("cat city"sv, MakeSearchCursor(full.documents[1]), 10);
+    ASSERT_EQUAL(tail.documents.size(), full.documents.size() - 2);
+    for (size_t i = 0; i < tail.documents.size(); ++i) {
+        ASSERT_EQUAL(tail.documents[i].id, full.documents[i + 2].id);
+    }
+
+    const SearchPage banned = search_server.FindTopDocumentsAfter("cat"sv, std::nullopt, 10, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned.documents.size(), 1u);
+    ASSERT(!banned.next_cursor);
+
+    try {
+        search_server.FindTopDocumentsAfter("cat"sv, std::nullopt, 0);
+        ASSERT_HINT(false, "page size must be positive"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestPaginator() {
+    const std::list<int> numbers = {1, 2, 3, 4, 5, 6, 7};
+
+    std::vector<std::vector<int>> pages;
+    for (const auto& page : Paginate(numbers, 3)) {
+        pages.emplace_back(page.begin(), page.end());
+        ASSERT_EQUAL(page.size(), static_cast<int>(pages.back().size()));
+    }
+    ASSERT(pages == std::vector<std::vector<int>>({{1, 2, 3}, {4, 5, 6}, {7}}));
+
+    const std::vector<int> empty;
+    const auto empty_pages = Paginate(empty, 3);
+    ASSERT(empty_pages.begin() == empty_pages.end());
+
+    const std::vector<int> exact = {1, 2, 3, 4};
+    int page_count = 0;
+    for (const auto& page : Paginate(exact, 2)) {
+        ASSERT_EQUAL(page.size(), 2);
+        ++page_count;
+    }
+    ASSERT_EQUAL(page_count, 2);
+}
+
+void TestPhraseQuery() {
+    SearchServer search_server("and with the"sv);
+    search_server.AddDocument(1, "fast search server in the cloud"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "search fast server"sv, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "fast and reliable search server"sv, DocumentStatus::ACTUAL, {3});
+
+    // без позиционного индекса фразы не поддерживаются
+    try {
+        search_server.FindTopDocuments("\"fast search\""sv);
+        ASSERT_HINT(false, "phrase query needs positional index"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    // индекс строится и по уже добавленным документам
+    search_server.EnablePositionalIndex();
+    ASSERT(search_server.IsPositionalIndexEnabled());
+    search_server.AddDocument(4, "server fast search server"sv, DocumentStatus::ACTUAL, {4});
+
+    auto found_ids = [&search_server](std::string_view query) {
+        std::vector<int> ids;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    ASSERT(found_ids("\"fast search server\""sv) == std::vector<int>({1, 4}));
+    // стоп-слова внутри фразы пропускаются и в документе, и в запросе
+    ASSERT(found_ids("\"fast the search\""sv) == std::vector<int>({1, 4}));
+    ASSERT(found_ids("\"fast search\"~1"sv) == std::vector<int>({1, 3, 4}));
+    ASSERT(found_ids("\"search fast\" \"fast server\""sv) == std::vector<int>({2}));
+    ASSERT(found_ids("\"fast search\" -cloud"sv) == std::vector<int>({4}));
+    // порядок слов во фразе важен
+    ASSERT(found_ids("\"server search\""sv).empty());
+
+    // релевантность по словам фразы считается как у обычных плюс-слов
+    ASSERT_EQUAL(search_server.FindTopDocuments("\"fast search\""sv).size(), 2u);
+    ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "\"fast search\" cloud"sv).size(), 2u);
+
+    {
+        const auto [words, status] = search_server.MatchDocument("\"search server\" cloud"sv, 1);
+        ASSERT_EQUAL(words.size(), 3u);
+        const auto [no_words, no_status] = search_server.MatchDocument("\"search server\""sv, 2);
+        ASSERT(no_words.empty());
+        const auto [par_words, par_status] = search_server.MatchDocument(std::execution::par, "\"search server\""sv, 2);
+        ASSERT(par_words.empty());
+    }
+
+    search_server.RemoveDocument(4);
+    ASSERT(found_ids("\"fast search server\""sv) == std::vector<int>({1}));
+
+    // позиции, не помещающиеся в один байт varint
+    std::string long_text;
+    for (int i = 0; i < 500; ++i) {
+        long_text += "word"s + std::to_string(i % 150) + " "s;
+    }
+    long_text += "rare phrase"s;
+    search_server.AddDocument(5, long_text, DocumentStatus::ACTUAL, {5});
+    ASSERT(found_ids("\"rare phrase\""sv) == std::vector<int>({5}));
+    ASSERT(found_ids("\"word49 rare\""sv) == std::vector<int>({5}));
+    ASSERT(found_ids("\"word149 word0\""sv) == std::vector<int>({5}));
+
+    for (std::string_view bad_query : {"\"fast search"sv, "\"\""sv, "-\"fast search\""sv, "\"fast\"~x"sv,
+                                         "\"fast search\"~1c"sv, "\"fast search\"~1\"rare phrase\""sv}) {
+        try {
+            search_server.FindTopDocuments(bad_query);
+            ASSERT_HINT(false, "invalid phrase syntax must throw"s);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestWildcardQuery() {
+    ASSERT(IsWildcardMatch("server"sv, "serv*"sv));
+    ASSERT(IsWildcardMatch("server"sv, "s*r"sv));
+    ASSERT(IsWildcardMatch("server"sv, "s*e*r*"sv));
+    ASSERT(!IsWildcardMatch("servers"sv, "s*r"sv));
+    ASSERT(!IsWildcardMatch("serve"sv, "serv*r"sv));
+
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "search server"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "service and servant"sv, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "observer"sv, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "ser"sv, DocumentStatus::ACTUAL, {4});
+
+    auto found_ids = [&search_server](std::string_view query) {
+        std::vector<int> ids;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    ASSERT(found_ids("serv*"sv) == std::vector<int>({1, 2}));
+    ASSERT(found_ids("ser*"sv) == std::vector<int>({1, 2, 4}));
+    ASSERT(found_ids("s*er"sv) == std::vector<int>({1, 4}));
+    ASSERT(found_ids("serv* -servant"sv) == std::vector<int>({1}));
+    ASSERT(found_ids("observer -serv*"sv) == std::vector<int>({3}));
+    ASSERT(found_ids("zzz*"sv).empty());
+
+    // раскрытые слова ранжируются как одно слово: документ 2 с двумя подходящими словами
+    // получает tf = 1, документ 1 -- 0.5, idf у них общий
+    const std::vector<Document> documents = search_server.FindTopDocuments("serv*"sv);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 2);
+    ASSERT(std::abs(documents[0].relevance - std::log(4.0 / 2)) < 1e-6);
+    ASSERT(std::abs(documents[1].relevance - std::log(4.0 / 2) / 2) < 1e-6);
+
+    const std::vector<Document> par_documents = search_server.FindTopDocuments(std::execution::par, "serv* -servant serv*"sv);
+    ASSERT_EQUAL(par_documents.size(), 1u);
+    ASSERT(std::abs(par_documents[0].relevance - documents[1].relevance) < 1e-6);
+
+    {
+        const auto [words, status] = search_server.MatchDocument("serv*"sv, 2);
+        ASSERT(words == std::vector<std::string_view>({"servant"sv, "service"sv}));
+        const auto [par_words, par_status] = search_server.MatchDocument(std::execution::par, "serv*"sv, 2);
+        ASSERT(par_words == words);
+        const auto [no_words, no_status] = search_server.MatchDocument(std::execution::par, "search -serv*"sv, 1);
+        ASSERT(no_words.empty());
+    }
+
+    {
+        QueryStats stats;
+        search_server.FindTopDocuments("serv* zzz* -ser*"sv, DocumentStatus::ACTUAL, &stats);
+        ASSERT_EQUAL(stats.plus_words, 2);
+        ASSERT_EQUAL(stats.plus_words_resolved, 1);
+        ASSERT_EQUAL(stats.minus_words_resolved, 1);
+    }
+
+    // снимок словаря уже построен запросами выше -- новые и пропавшие слова доходят до него без пересборки
+    search_server.AddDocument(5, "servers serval"sv, DocumentStatus::ACTUAL, {5});
+    ASSERT(found_ids("serv*"sv) == std::vector<int>({1, 2, 5}));
+    search_server.RemoveDocument(2);
+    search_server.UpdateDocument(5, "serval"sv);
+    ASSERT(found_ids("serv*"sv) == std::vector<int>({1, 5}));
+    {
+        const auto [words, status] = search_server.MatchDocument("serv*"sv, 5);
+        ASSERT(words == std::vector<std::string_view>({"serval"sv}));
+    }
+    search_server.AddDocument(2, "service and servant"sv, DocumentStatus::ACTUAL, {2});
+    ASSERT(found_ids("servi*"sv) == std::vector<int>({2}));
+
+    // ранжирование по шаблону ограничено MAX_PATTERN_EXPANSIONS словами словаря
+    SearchServer many_words_server("and"sv);
+    for (int i = 0; i < MAX_PATTERN_EXPANSIONS + 10; ++i) {
+        many_words_server.AddDocument(i, "word"s + std::to_string(1000 + i), DocumentStatus::ACTUAL, {1});
+    }
+    QueryStats stats;
+    many_words_server.FindTopDocuments("word*"sv, DocumentStatus::ACTUAL, &stats);
+    ASSERT_EQUAL(stats.postings_scanned, static_cast<uint64_t>(MAX_PATTERN_EXPANSIONS));
+
+    for (std::string_view bad_query : {"*"sv, "*erver"sv, "-*"sv}) {
+        try {
+            search_server.FindTopDocuments(bad_query);
+            ASSERT_HINT(false, "wildcard without prefix must throw"s);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestFuzzyQuery() {
+    {
+        const LevenshteinAutomaton automaton("server"sv, 1);
+        auto run = [&automaton](std::string_view word) {
+            std::vector<int> state(automaton.GetStateSize());
+            std::vector<int> next(automaton.GetStateSize());
+            automaton.Start(state.data());
+            for (size_t depth = 0; depth < word.size(); ++depth) {
+                automaton.Step(state.data(), depth, word[depth], next.data());
+                state.swap(next);
+            }
+            return state;
+        };
+        auto distance = [&automaton, &run](std::string_view word) {
+            return automaton.GetDistance(run(word).data(), word.size());
+        };
+        ASSERT_EQUAL(distance("server"sv), 0);
+        ASSERT_EQUAL(distance("sever"sv), 1);
+        ASSERT_EQUAL(distance("servers"sv), 1);
+        ASSERT_EQUAL(distance("servar"sv), 1);
+        ASSERT_EQUAL(distance("sevre"sv), 2); // больше допустимого -- max_distance + 1
+        ASSERT_EQUAL(distance("s"sv), 2);
+        ASSERT(automaton.IsMatch(run("erver"sv).data(), 5));
+        ASSERT(!automaton.IsMatch(run("serverss"sv).data(), 8));
+        ASSERT(automaton.CanMatch(run("se"sv).data()));
+        ASSERT(!automaton.CanMatch(run("xy"sv).data()));
+    }
+
+    {
+        // обход словаря автоматом находит ровно то же, что полный перебор с честным подсчетом расстояния
+        auto levenshtein = [](std::string_view lhs, std::string_view rhs) {
+            std::vector<int> row(rhs.size() + 1);
+            for (size_t j = 0; j < row.size(); ++j) {
+                row[j] = j;
+            }
+            for (size_t i = 1; i <= lhs.size(); ++i) {
+                int diagonal = row[0];
+                row[0] = i;
+                for (size_t j = 1; j <= rhs.size(); ++j) {
+                    const int above = row[j];
+                    row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (lhs[i - 1] != rhs[j - 1])});
+                    diagonal = above;
+                }
+            }
+            return row.back();
+        };
+
+        std::mt19937 generator;
+        std::set<std::string> words;
+        while (words.size() < 300) {
+            std::string word(std::uniform_int_distribution(1, 7)(generator), 'a');
+            for (char& c : word) {
+                c = std::uniform_int_distribution('a', 'c')(generator);
+            }
+            words.insert(word);
+        }
+        const TermDictionary dictionary(std::vector<std::string_view>(words.begin(), words.end()));
+        ASSERT_EQUAL(dictionary.Size(), 300u);
+
+        for (const std::string_view query : {"abcab"sv, "c"sv, "aaaaaaaa"sv, "bcbcb"sv, "x"sv}) {
+            for (int max_distance = 1; max_distance <= 2; ++max_distance) {
+                std::vector<std::pair<int, std::string_view>> expected;
+                for (const std::string& word : words) {
+                    const int word_distance = levenshtein(query, word);
+                    if (word_distance <= max_distance) {
+                        expected.emplace_back(word_distance, word);
+                    }
+                }
+                ASSERT(dictionary.FindFuzzy(LevenshteinAutomaton(query, max_distance)) == expected);
+            }
+        }
+
+        // снимок, который обновлялся по слову за раз (с дельтой, слияниями и пропавшими словами), ищет так же,
+        // как полный перебор живых слов
+        std::set<std::string, std::less<>> live_words;
+        std::list<std::string> storage; // строки должны пережить словарь
+        const TermDictionary::TermFilter is_live = [&live_words](std::string_view term) { return live_words.count(term) > 0; };
+        std::shared_ptr<const TermDictionary> updated = std::make_shared<const TermDictionary>(std::vector<std::string_view>());
+        for (int step = 1; step <= 3000; ++step) {
+            std::string word(std::uniform_int_distribution(1, 5)(generator), 'a');
+            for (char& c : word) {
+                c = std::uniform_int_distribution('a', 'c')(generator);
+            }
+            if (live_words.count(word) > 0) {
+                live_words.erase(word);
+                updated = updated->Update({}, 1, is_live);
+            } else {
+                storage.push_back(word);
+                live_words.insert(word);
+                updated = updated->Update({storage.back()}, 0, is_live);
+            }
+
+            if (step % 100 != 0) {
+                continue;
+            }
+            ASSERT_EQUAL(updated->Size(), live_words.size());
+            std::vector<std::string_view> expected_prefix;
+            for (auto it = live_words.lower_bound("ab"sv); it != live_words.end() && it->rfind("ab"sv, 0) == 0; ++it) {
+                expected_prefix.push_back(*it);
+            }
+            ASSERT(updated->FindPrefix("ab"sv, live_words.size(), is_live) == expected_prefix);
+
+            std::vector<std::pair<int, std::string_view>> expected_fuzzy;
+            for (const std::string& live_word : live_words) {
+                if (const int word_distance = levenshtein("abca"sv, live_word); word_distance <= 2) {
+                    expected_fuzzy.emplace_back(word_distance, live_word);
+                }
+            }
+            std::vector<std::pair<int, std::string_view>> fuzzy = updated->FindFuzzy(LevenshteinAutomaton("abca"sv, 2));
+            fuzzy.erase(std::remove_if(fuzzy.begin(), fuzzy.end(), [&is_live](const auto& match) { return !is_live(match.second); }),
+                        fuzzy.end());
+            ASSERT(fuzzy == expected_fuzzy);
+        }
+    }
+
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "search server"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "fast service"sv, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "observer cat"sv, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "sever cot"sv, DocumentStatus::ACTUAL, {4});
+
+    // по умолчанию опечатки не исправляются
+    ASSERT(search_server.FindTopDocuments("servre"sv).empty());
+
+    search_server.SetFuzzyDistance(2);
+    ASSERT_EQUAL(search_server.GetFuzzyDistance(), 2);
+
+    auto found_ids = [&search_server](std::string_view query) {
+        std::vector<int> ids;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            ids.push_back(document.id);
+        }
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    ASSERT(found_ids("servre"sv) == std::vector<int>({1, 2})); // server и service на расстоянии 2, sever -- 3
+    ASSERT(found_ids("sevrice"sv) == std::vector<int>({2}));
+    // известное индексу слово ищется точно, без соседей по расстоянию
+    ASSERT(found_ids("sever"sv) == std::vector<int>({4}));
+    // слова короче 3 букв не исправляются, короче 6 -- не дальше 1
+    ASSERT(found_ids("ca"sv).empty());
+    ASSERT(found_ids("kat"sv) == std::vector<int>({3})); // cat; cot на расстоянии 2
+    ASSERT(found_ids("servre -search"sv) == std::vector<int>({2}));
+    ASSERT(found_ids(std::string(40, 'q')).empty());
+
+    ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "servre"sv).size(), 2u);
+
+    {
+        const auto [words, status] = search_server.MatchDocument("servre"sv, 1);
+        ASSERT(words == std::vector<std::string_view>({"server"sv}));
+        const auto [par_words, par_status] = search_server.MatchDocument(std::execution::par, "servre fas"sv, 2);
+        ASSERT(par_words == std::vector<std::string_view>({"fast"sv, "service"sv}));
+    }
+
+    search_server.SetFuzzyDistance(1);
+    ASSERT(found_ids("servre"sv).empty());
+    ASSERT(found_ids("servr"sv) == std::vector<int>({1}));
+
+    try {
+        search_server.SetFuzzyDistance(3);
+        ASSERT_HINT(false, "fuzzy distance above 2 must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestSynonymExpansion() {
+    {
+        const std::vector<std::pair<std::string, std::string>> pairs = {
+            {"kitten"s, "cat"s}, {"cat"s, "kitten"s}, {"kitty"s, "kitten"s}, {"dog"s, "dog"s}};
+        const SynonymGraph synonyms(pairs);
+        ASSERT_EQUAL(synonyms.GetWordCount(), 4u);
+        ASSERT_EQUAL(synonyms.GetSynonymCount("kitten"sv), 2u);
+        ASSERT_EQUAL(synonyms.GetSynonymCount("cat"sv), 1u); // повтор пары в обратную сторону не считается
+        ASSERT_EQUAL(synonyms.GetSynonymCount("dog"sv), 0u);
+        ASSERT_EQUAL(synonyms.GetSynonymCount("rat"sv), 0u);
+        ASSERT(synonyms.AreSynonyms("cat"sv, "kitten"sv));
+        ASSERT(synonyms.AreSynonyms("kitten"sv, "cat"sv));
+        ASSERT(!synonyms.AreSynonyms("cat"sv, "kitty"sv)); // отношение не транзитивно
+        ASSERT(!synonyms.AreSynonyms("rat"sv, "cat"sv));
+
+        std::vector<std::string_view> kitten_synonyms;
+        synonyms.ForEachSynonym("kitten"sv, [&kitten_synonyms](std::string_view word) { kitten_synonyms.push_back(word); });
+        ASSERT(kitten_synonyms == std::vector<std::string_view>({"cat"sv, "kitty"sv}));
+
+        // вью смотрят в собственное хранилище графа, поэтому копия самостоятельна
+        const SynonymGraph copy = synonyms;
+        ASSERT(copy.AreSynonyms("kitty"sv, "kitten"sv));
+    }
+
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "cat"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "kitten toy"sv, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "dog"sv, DocumentStatus::ACTUAL, {3});
+
+    // без графа синонимов запрос не расширяется
+    ASSERT(search_server.FindTopDocuments("kitten"sv).size() == 1u);
+
+    search_server.SetSynonyms(SynonymGraph(std::vector<std::pair<std::string_view, std::string_view>>{
+        {"kitten"sv, "cat"sv}, {"kitten"sv, "kitty"sv}, {"dog"sv, "puppy"sv}}), 0.5);
+    ASSERT_EQUAL(search_server.GetSynonyms().GetWordCount(), 5u);
+
+    auto relevance_by_id = [&search_server](std::string_view query, auto policy) {
+        std::map<int, double> relevance;
+        for (const Document& document : search_server.FindTopDocuments(policy, query)) {
+            relevance[document.id] = document.relevance;
+        }
+        return relevance;
+    };
+
+    const double idf = std::log(3.0);
+    for (const auto& relevance : {relevance_by_id("kitten"sv, std::execution::seq), relevance_by_id("kitten"sv, std::execution::par)}) {
+        ASSERT_EQUAL(relevance.size(), 2u);
+        ASSERT(std::abs(relevance.at(1) - 0.5 * idf) < 1e-6); // cat -- синоним с весом 0.5
+        ASSERT(std::abs(relevance.at(2) - 0.5 * idf) < 1e-6); // kitten с tf 1/2
+    }
+
+    // синоним, который и так есть в запросе, не ранжируется второй раз
+    {
+        const auto relevance = relevance_by_id("cat kitten"sv, std::execution::seq);
+        ASSERT(std::abs(relevance.at(1) - idf) < 1e-6);
+        ASSERT(std::abs(relevance.at(2) - 0.5 * idf) < 1e-6);
+    }
+
+    // самих puppy и kitty в индексе нет -- документы находятся только по синонимам
+    ASSERT(relevance_by_id("puppy"sv, std::execution::seq) == (std::map<int, double>{{3, 0.5 * idf}}));
+    ASSERT(relevance_by_id("kitty"sv, std::execution::seq) == (std::map<int, double>{{2, 0.25 * idf}}));
+    ASSERT(relevance_by_id("kitten -cat"sv, std::execution::seq) == (std::map<int, double>{{2, 0.5 * idf}}));
+
+    {
+        const auto [words, status] = search_server.MatchDocument("kitten"sv, 1);
+        ASSERT(words == std::vector<std::string_view>({"cat"sv}));
+        const auto [par_words, par_status] = search_server.MatchDocument(std::execution::par, "kitty"sv, 2);
+        ASSERT(par_words == std::vector<std::string_view>({"kitten"sv}));
+    }
+
+    search_server.SetSynonyms(SynonymGraph());
+    ASSERT(search_server.FindTopDocuments("kitten"sv).size() == 1u);
+
+    try {
+        search_server.SetSynonyms(SynonymGraph(), 1.5);
+        ASSERT_HINT(false, "synonym weight above 1 must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestBm25Ranking() {
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "cat dog"sv, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "cat"sv, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(3, "bird fish fish fish"sv, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(4, "dog and bird"sv, DocumentStatus::BANNED, {4});
+
+    ASSERT(search_server.GetRankingFunction() == RankingFunction::TF_IDF);
+    search_server.SetRankingFunction(RankingFunction::BM25);
+    ASSERT(search_server.GetRankingFunction() == RankingFunction::BM25);
+
+    // BM25 по определению, с частотой слова f в документе длины length
+    auto bm25 = [](double f, double length, double document_count, double document_freq, double average_length) {
+        const double k1 = 1.2;
+        const double b = 0.75;
+        const double idf = std::log(1 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+        return idf * f * (k1 + 1) / (f + k1 * (1 - b + b * length / average_length));
+    };
+
+    auto relevance_by_id = [&search_server](std::string_view query, auto policy) {
+        std::map<int, double> relevance;
+        for (const Document& document : search_server.FindTopDocuments(policy, query, [](int, DocumentStatus, int) { return true; })) {
+            relevance[document.id] = document.relevance;
+        }
+        return relevance;
+    };
+
+    const double average_length = (2 + 1 + 4 + 2) / 4.0;
+    for (const auto& relevance : {relevance_by_id("cat fish"sv, std::execution::seq), relevance_by_id("cat fish"sv, std::execution::par)}) {
+        ASSERT_EQUAL(relevance.size(), 3u);
+        ASSERT(std::abs(relevance.at(1) - bm25(1, 2, 4, 2, average_length)) < 1e-9);
+        ASSERT(std::abs(relevance.at(2) - bm25(1, 1, 4, 2, average_length)) < 1e-9);
+        ASSERT(std::abs(relevance.at(3) - bm25(3, 4, 4, 1, average_length)) < 1e-9);
+    }
+
+    // короткий документ выше длинного при одинаковой частоте -- нормировка по длине работает
+    ASSERT(relevance_by_id("cat"sv, std::execution::seq).at(2) > relevance_by_id("cat"sv, std::execution::seq).at(1));
+
+    // шаблоны ранжируются той же функцией: fi* раскрывается в fish
+    ASSERT(relevance_by_id("fi*"sv, std::execution::seq) == relevance_by_id("fish"sv, std::execution::seq));
+
+    // средняя длина меняется с добавлением и удалением документов, нормы пересчитываются
+    search_server.AddDocument(5, "cat cat"sv, DocumentStatus::ACTUAL, {5});
+    {
+        const double new_average_length = (2 + 1 + 4 + 2 + 2) / 5.0;
+        const auto relevance = relevance_by_id("cat"sv, std::execution::seq);
+        ASSERT(std::abs(relevance.at(5) - bm25(2, 2, 5, 3, new_average_length)) < 1e-9);
+    }
+    search_server.RemoveDocument(3);
+    ASSERT(std::abs(relevance_by_id("dog"sv, std::execution::par).at(1) - bm25(1, 2, 4, 2, (2 + 1 + 2 + 2) / 4.0)) < 1e-9);
+
+    {
+        // постингов больше блока ядра; отсеянные фильтром не ранжируются
+        SearchServer large_server(""sv);
+        for (int id = 0; id < 300; ++id) {
+            large_server.AddDocument(id, id % 3 == 0 ? "word tail"sv : "word"sv, id % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, {id});
+        }
+        large_server.SetRankingFunction(RankingFunction::BM25, {2.0, 0.5});
+
+        QueryStats stats;
+        const std::vector<Document> documents = large_server.FindTopDocuments("word"sv, DocumentStatus::ACTUAL, &stats);
+        ASSERT_EQUAL(stats.rejected_by_filter, 150u);
+        ASSERT_EQUAL(stats.candidates_sorted, 150u);
+        // документы без tail короче, поэтому выше; среди равных -- по рейтингу
+        ASSERT_EQUAL(documents.front().id, 298);
+        ASSERT(documents.front().relevance > 0);
+
+        const std::vector<Document> par_documents = large_server.FindTopDocuments(std::execution::par, "word"sv, DocumentStatus::ACTUAL);
+        ASSERT_EQUAL(par_documents.size(), documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(par_documents[i].id, documents[i].id);
+            ASSERT(std::abs(par_documents[i].relevance - documents[i].relevance) < 1e-9);
+        }
+    }
+
+    try {
+        search_server.SetRankingFunction(RankingFunction::BM25, {1.2, 1.5});
+        ASSERT_HINT(false, "b above 1 must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestQueryDeadline() {
+    using namespace std::chrono;
+
+    SearchServer search_server("and with"sv);
+    for (int id = 0; id < 5000; ++id) {
+        search_server.AddDocument(id, id % 10 == 0 ? "word bad"sv : "word"sv, DocumentStatus::ACTUAL, {id});
+    }
+
+    {
+        // без срока -- та же выдача, что у обычного поиска
+        const SearchResult result = search_server.FindTopDocumentsWithDeadline("word -bad"sv, QueryDeadline{});
+        ASSERT(!result.is_truncated);
+        const std::vector<Document> expected = search_server.FindTopDocuments("word -bad"sv);
+        ASSERT_EQUAL(result.documents.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(result.documents[i].id, expected[i].id);
+        }
+    }
+
+    {
+        // срок уже прошел или запрос отменен до начала -- ничего не ранжируется
+        const SearchResult expired = search_server.FindTopDocumentsWithDeadline("word"sv, QueryDeadline::After(-milliseconds(1)));
+        ASSERT(expired.is_truncated);
+        ASSERT(expired.documents.empty());
+
+        const CancellationToken token;
+        token.Cancel();
+        ASSERT(search_server.FindTopDocumentsWithDeadline("word"sv, QueryDeadline{QueryDeadline::Clock::time_point::max(), token}).is_truncated);
+    }
+
+    {
+        // отмена посреди обхода постингов: предикат фильтра отменяет запрос на 1500-м документе,
+        // поиск останавливается на ближайшей проверке и отдает лучшие из посчитанных, минус-слова по-прежнему вычеркивают
+        const CancellationToken token;
+        int calls = 0;
+        const SearchResult result = search_server.FindTopDocumentsWithDeadline("word -bad"sv, QueryDeadline{QueryDeadline::Clock::time_point::max(), token},
+            Where([&token, &calls](int, DocumentStatus, int) {
+                if (++calls == 1500) {
+                    token.Cancel();
+                }
+                return true;
+            }));
+        ASSERT(result.is_truncated);
+        ASSERT(calls < 5000);
+        ASSERT_EQUAL(result.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+        for (const Document& document : result.documents) {
+            ASSERT(document.id < calls);
+            ASSERT(document.id % 10 != 0);
+        }
+    }
+
+    {
+        std::future<SearchResult> future = search_server.FindTopDocumentsAsync(std::string("word -bad"s), QueryDeadline::After(seconds(60)));
+        const SearchResult result = future.get();
+        ASSERT(!result.is_truncated);
+        ASSERT_EQUAL(result.documents.front().id, 4999);
+
+        std::future<SearchResult> invalid = search_server.FindTopDocumentsAsync("word --bad"sv);
+        try {
+            invalid.get();
+            ASSERT_HINT(false, "invalid query must throw through the future"s);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestProcessQueriesAdmission() {
+    SearchServer search_server("and with"sv);
+    for (int id = 0; id < 200; ++id) {
+        search_server.AddDocument(id, "common word"s + std::to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+
+    ASSERT_EQUAL(search_server.EstimateQueryCost("word7"sv), 1u);
+    ASSERT_EQUAL(search_server.EstimateQueryCost("common -word7 unknown"sv), 201u);
+    ASSERT_EQUAL(search_server.EstimateQueryCost("word*"sv), static_cast<uint64_t>(MAX_PATTERN_EXPANSIONS));
+
+    auto admissions = [](const std::vector<ProcessedQuery>& processed) {
+        std::vector<QueryAdmission> result;
+        for (const ProcessedQuery& query : processed) {
+            result.push_back(query.admission);
+        }
+        return result;
+    };
+
+    const std::vector<std::string> queries = {"common"s, "word1"s, "word2 common"s, "word3"s};
+
+    {
+        // без ограничений -- то же, что обычный ProcessQueries
+        AdmissionExecutor executor(search_server, AdmissionLimits{});
+        const std::vector<ProcessedQuery> processed = executor.ProcessQueries(queries);
+        const std::vector<std::vector<Document>> expected = ProcessQueries(search_server, queries);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT(processed[i].admission == QueryAdmission::EXECUTED);
+            ASSERT_EQUAL(processed[i].documents.size(), expected[i].size());
+            ASSERT_EQUAL(processed[i].documents.front().id, expected[i].front().id);
+        }
+    }
+
+    AdmissionLimits limits;
+    limits.max_concurrency = 2;
+    limits.max_cost = 100;
+
+    {
+        AdmissionExecutor executor(search_server, limits);
+        AdmissionStats stats;
+        const std::vector<ProcessedQuery> processed = executor.ProcessQueries(queries, &stats);
+        ASSERT(admissions(processed) == std::vector<QueryAdmission>({QueryAdmission::SHED_TOO_EXPENSIVE, QueryAdmission::EXECUTED,
+                                                                     QueryAdmission::SHED_TOO_EXPENSIVE, QueryAdmission::EXECUTED}));
+        ASSERT(processed[0].documents.empty());
+        ASSERT_EQUAL(processed[1].documents.front().id, 1);
+        ASSERT_EQUAL(stats.executed, 2u);
+        ASSERT_EQUAL(stats.shed_too_expensive, 2u);
+    }
+
+    limits.expensive_query_policy = ExpensiveQueryPolicy::DEGRADE;
+    {
+        limits.degraded_timeout = std::chrono::seconds(60);
+        AdmissionExecutor executor(search_server, limits);
+        const std::vector<ProcessedQuery> processed = executor.ProcessQueries(queries);
+        ASSERT(processed[2].admission == QueryAdmission::DEGRADED);
+        ASSERT(!processed[2].is_truncated);
+        ASSERT_EQUAL(processed[2].documents.front().id, 2);
+
+        // срок меньше нуля: дорогие запросы прерываются сразу
+        limits.degraded_timeout = -std::chrono::milliseconds(1);
+        AdmissionExecutor hurried(search_server, limits);
+        AdmissionStats stats;
+        const std::vector<ProcessedQuery> truncated = hurried.ProcessQueries(queries, &stats);
+        ASSERT(truncated[0].is_truncated);
+        ASSERT(truncated[0].documents.empty());
+        ASSERT_EQUAL(stats.degraded, 2u);
+        ASSERT_EQUAL(stats.truncated, 2u);
+        ASSERT_EQUAL(stats.executed, 2u);
+    }
+
+    {
+        // мест 2 + 3: приостановленный исполнитель не разбирает очередь, и занятость видна точно
+        limits.expensive_query_policy = ExpensiveQueryPolicy::REJECT;
+        limits.max_queue_depth = 3;
+        AdmissionExecutor executor(search_server, limits);
+
+        std::vector<std::string> burst = {"common"s};
+        for (int i = 0; i < 9; ++i) {
+            burst.push_back("word"s + std::to_string(i));
+        }
+
+        // пока место есть, вся пачка допускается, сколько бы запросов в ней ни было до этого
+        for (int round = 0; round < 2; ++round) {
+            for (const std::string& query : burst) {
+                const ProcessedQuery processed = executor.Submit(query).get();
+                ASSERT(processed.admission == (query == "common"s ? QueryAdmission::SHED_TOO_EXPENSIVE : QueryAdmission::EXECUTED));
+            }
+        }
+        ASSERT_EQUAL(executor.GetOccupancy(), 0u);
+
+        // два вызывающих потока делят одни места: допущено 5 запросов на двоих, остальные отброшены сразу
+        executor.Pause();
+        std::vector<std::future<ProcessedQuery>> futures;
+        std::mutex futures_guard;
+        std::vector<std::thread> callers;
+        for (int caller = 0; caller < 2; ++caller) {
+            callers.emplace_back([&executor, &burst, &futures, &futures_guard]() {
+                for (const std::string& query : burst) {
+                    std::future<ProcessedQuery> future = executor.Submit(query);
+                    std::lock_guard guard(futures_guard);
+                    futures.push_back(std::move(future));
+                }
+            });
+        }
+        for (std::thread& caller : callers) {
+            caller.join();
+        }
+        ASSERT_EQUAL(executor.GetOccupancy(), 5u);
+        const AdmissionStats paused = executor.GetStats();
+        ASSERT_EQUAL(paused.shed_too_expensive, 2u + 2u);
+        ASSERT_EQUAL(paused.shed_queue_full, 18u - 5u);
+
+        executor.Resume();
+        size_t executed = 0;
+        for (std::future<ProcessedQuery>& future : futures) {
+            const ProcessedQuery processed = future.get();
+            executed += processed.admission == QueryAdmission::EXECUTED;
+            ASSERT(processed.admission != QueryAdmission::EXECUTED || !processed.documents.empty());
+        }
+        ASSERT_EQUAL(executed, 5u);
+        ASSERT_EQUAL(executor.GetOccupancy(), 0u);
+        ASSERT_EQUAL(executor.GetStats().executed, 18u + 5u);
+    }
+
+    try {
+        AdmissionExecutor executor(search_server, AdmissionLimits{});
+        executor.ProcessQueries({"word1"s, "--word2"s});
+        ASSERT_HINT(false, "invalid query must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestNumaExecutor() {
+    const std::vector<NumaNode> topology = GetNumaTopology();
+    ASSERT(!topology.empty());
+    for (const NumaNode& node : topology) {
+        ASSERT(!node.cpus.empty());
+    }
+
+    std::optional<SearchServer> original;
+    original.emplace("and with"sv);
+    original->EnablePositionalIndex();
+    original->SetRankingFunction(RankingFunction::BM25);
+    for (int id = 0; id < 50; ++id) {
+        original->AddDocument(id, "funny pet "s + std::to_string(id % 7) + (id % 3 == 0 ? " nasty rat"s : " curly hair"s), DocumentStatus::ACTUAL, {id});
+    }
+    original->RemoveDocument(3);
+
+    const std::vector<std::string> queries = {"funny pet"s, "nasty -curly"s, "\"nasty rat\" 5"s, "hair 2"s};
+    const std::vector<std::vector<Document>> expected = ProcessQueries(*original, queries);
+
+    auto assert_same = [&expected](const std::vector<std::vector<Document>>& result) {
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(result[i].size(), expected[i].size());
+            for (size_t j = 0; j < expected[i].size(); ++j) {
+                ASSERT_EQUAL(result[i][j].id, expected[i][j].id);
+                ASSERT(std::abs(result[i][j].relevance - expected[i][j].relevance) < 1e-9);
+            }
+        }
+    };
+
+    {
+        // копия самостоятельна: переживает оригинал, настройки поиска те же, удаленный документ не переносится
+        const SearchServer copy(*original);
+        original->AddDocument(100, "funny funny funny"sv, DocumentStatus::ACTUAL, {100});
+        original->RemoveDocument(100);
+        const SearchServer moved{SearchServer(*original)};
+        original.reset();
+
+        ASSERT_EQUAL(copy.GetDocumentCount(), 49);
+        ASSERT(copy.IsPositionalIndexEnabled());
+        ASSERT(copy.GetRankingFunction() == RankingFunction::BM25);
+        assert_same(ProcessQueries(copy, queries));
+        assert_same(ProcessQueries(moved, queries));
+
+#ifdef __linux__
+        // процессоры узла могут не входить в cpuset процесса (контейнер на другом сокете), и тогда false --
+        // законный ответ; к процессорам, которые процессу доступны, привязка удается всегда
+        std::thread pinned([]() {
+            cpu_set_t allowed;
+            ASSERT_EQUAL(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            ASSERT(PinCurrentThread(cpus));
+        });
+        pinned.join();
+#endif
+
+        NumaExecutor executor(copy);
+        ASSERT_EQUAL(executor.GetNodeCount(), topology.size());
+        ASSERT_EQUAL(executor.HasReplicas(), topology.size() > 1);
+        assert_same(executor.ProcessQueries(queries));
+
+        NumaExecutor replicated(copy, 2, true);
+        ASSERT(replicated.HasReplicas());
+        assert_same(replicated.ProcessQueries(queries));
+
+        std::future<std::vector<Document>> invalid = replicated.Submit("funny --pet"s);
+        try {
+            invalid.get();
+            ASSERT_HINT(false, "invalid query must throw through the future"s);
+        } catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestMemoryUsage() {
+    SearchServer search_server("and with"sv);
+    const MemoryUsage empty = search_server.GetMemoryUsage();
+    ASSERT_EQUAL(empty.term_index, 0u);
+    ASSERT_EQUAL(empty.document_ids, 0u);
+
+    search_server.EnablePositionalIndex();
+    for (int id = 0; id < 20; ++id) {
+        search_server.AddDocument(id, "funny pet "s + std::to_string(id) + " and nasty rat"s, DocumentStatus::ACTUAL, {id});
+    }
+
+    const MemoryUsage filled = search_server.GetMemoryUsage();
+    ASSERT(filled.documents_text >= empty.documents_text + 20 * "funny pet 0 and nasty rat"s.size());
+    ASSERT(filled.term_index > 0 && filled.document_index > 0 && filled.document_ids > 0);
+    ASSERT(filled.columns >= 20 * 3 * sizeof(int));
+    ASSERT(filled.positional_index > 0);
+    ASSERT_EQUAL(filled.total, filled.documents_text + filled.term_index + filled.document_index + filled.document_ids
+                                   + filled.columns + filled.positional_index + filled.caches);
+
+    // удаление освобождает постинги, но текст и строка в колонках остаются до Compact
+    for (int id = 0; id < 20; id += 2) {
+        search_server.RemoveDocument(id);
+    }
+    const MemoryUsage removed = search_server.GetMemoryUsage();
+    ASSERT(removed.term_index < filled.term_index);
+    ASSERT(removed.document_index < filled.document_index);
+    ASSERT_EQUAL(removed.documents_text, filled.documents_text);
+
+    const std::vector<Document> before = search_server.FindTopDocuments("pet 5"sv);
+    search_server.Compact();
+    const MemoryUsage compacted = search_server.GetMemoryUsage();
+    ASSERT(compacted.documents_text < removed.documents_text);
+    ASSERT(compacted.columns < removed.columns);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 10);
+
+    const std::vector<Document> after = search_server.FindTopDocuments("pet 5"sv);
+    ASSERT_EQUAL(after.size(), before.size());
+    for (size_t i = 0; i < before.size(); ++i) {
+        ASSERT_EQUAL(after[i].id, before[i].id);
+        ASSERT(std::abs(after[i].relevance - before[i].relevance) < 1e-9);
+    }
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("\"nasty rat\""sv, 5)).size(), 2u);
+
+    {
+        // без уплотнения: документ за бюджет отвергается, индекс не меняется
+        SearchServer limited(search_server);
+        limited.SetMemoryBudget(limited.GetMemoryUsage().total + 8);
+        try {
+            limited.AddDocument(100, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {1});
+            ASSERT_HINT(false, "document over the budget must throw"s);
+        } catch (const std::invalid_argument&) {
+        }
+        ASSERT_EQUAL(limited.GetDocumentCount(), 10);
+        ASSERT(limited.FindTopDocuments("funny"sv).size() == 5);
+    }
+    {
+        // с уплотнением: места от удаленных документов хватает на новый
+        SearchServer limited("and with"sv);
+        for (int id = 0; id < 20; ++id) {
+            limited.AddDocument(id, "funny pet "s + std::to_string(id) + " and nasty rat"s, DocumentStatus::ACTUAL, {id});
+        }
+        limited.SetMemoryBudget(limited.GetMemoryUsage().total, MemoryBudgetPolicy::COMPACT);
+        for (int id = 0; id < 20; id += 2) {
+            limited.RemoveDocument(id);
+        }
+        limited.AddDocument(100, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {1});
+        ASSERT_EQUAL(limited.GetDocumentCount(), 11);
+        ASSERT(limited.GetMemoryUsage().total <= limited.GetMemoryBudget());
+    }
+}
+
+void TestMemoryResource() {
+    // ресурс, который помнит, сколько байт из него сейчас занято
+    class TrackingResource : public std::pmr::memory_resource {
+    public:
+        size_t in_use = 0;
+        size_t allocations = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            in_use += bytes;
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            in_use -= bytes;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    auto fill = [](SearchServer& search_server) {
+        search_server.EnablePositionalIndex();
+        for (int id = 0; id < 30; ++id) {
+            search_server.AddDocument(id, "funny pet "s + std::to_string(id % 4) + " and nasty rat number "s + std::to_string(id),
+                                      DocumentStatus::ACTUAL, {id});
+        }
+        search_server.RemoveDocument(std::execution::par, 7);
+    };
+
+    SearchServer expected("and with"sv);
+    fill(expected);
+    const std::vector<std::string> queries = {"funny pet 2"s, "\"nasty rat\" -3"s, "number 17"s};
+
+    TrackingResource tracking;
+    {
+        SearchServer search_server("and with"sv, &tracking);
+        fill(search_server);
+        ASSERT(tracking.allocations > 0);
+        // тексты, колонки и битмапы статусов -- в переданном ресурсе
+        const MemoryUsage usage = search_server.GetMemoryUsage();
+        ASSERT(tracking.in_use >= usage.documents_text + usage.columns);
+
+        const SearchServer copy(search_server, &tracking);
+        for (const std::string& query : queries) {
+            const std::vector<Document> lhs = expected.FindTopDocuments(query);
+            for (const SearchServer* server : {&std::as_const(search_server), &copy}) {
+                const std::vector<Document> rhs = server->FindTopDocuments(query);
+                ASSERT_EQUAL(lhs.size(), rhs.size());
+                for (size_t i = 0; i < lhs.size(); ++i) {
+                    ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+                }
+            }
+        }
+
+        search_server.Compact();
+        ASSERT_EQUAL(search_server.FindTopDocuments("17"sv).size(), 1u);
+    }
+    // вся память индексов вернулась в ресурс
+    ASSERT_EQUAL(tracking.in_use, 0u);
+
+    {
+        // аренда: память освобождается разом вместе с буфером
+        std::pmr::monotonic_buffer_resource arena;
+        SearchServer search_server("and with"sv, &arena);
+        fill(search_server);
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 29);
+        ASSERT_EQUAL(search_server.FindTopDocuments("17"sv).size(), 1u);
+    }
+}
+
+void TestScratchArena() {
+    // арену проверяем на отдельном потоке: у него своя, еще не тронутая запросами
+    std::thread worker([]() {
+        ScratchArena& arena = ScratchArena::ForCurrentThread();
+        ASSERT_EQUAL(arena.GetCapacity(), ScratchArena::INITIAL_CAPACITY);
+
+        {
+            ScratchArena::Scope outer;
+            std::pmr::vector<int> numbers(outer.GetResource());
+            numbers.push_back(1);
+            {
+                // вложенный Scope не сбрасывает арену -- память внешнего остается действительной
+                ScratchArena::Scope inner;
+                ASSERT(inner.GetResource() == outer.GetResource());
+                std::pmr::vector<int> other(inner.GetResource());
+                other.assign(100, 2);
+            }
+            numbers.push_back(3);
+            ASSERT_EQUAL(numbers[0] + numbers[1], 4);
+
+            // не влезает в буфер -- берется из кучи, а при сбросе буфер дорастает до этого объема
+            std::pmr::vector<char> large(ScratchArena::INITIAL_CAPACITY * 2, 'a', outer.GetResource());
+        }
+        ASSERT(arena.GetCapacity() > ScratchArena::INITIAL_CAPACITY * 2);
+
+        SearchServer search_server("and with"sv);
+        for (int id = 0; id < 100; ++id) {
+            search_server.AddDocument(id, "funny pet "s + std::to_string(id % 9), DocumentStatus::ACTUAL, {id});
+        }
+        const size_t capacity = arena.GetCapacity();
+        for (int i = 0; i < 3; ++i) {
+            ASSERT_EQUAL(search_server.FindTopDocuments("pet -3"sv).size(), 5u);
+        }
+        ASSERT_EQUAL(arena.GetCapacity(), capacity);
+    });
+    worker.join();
+}
+
+void TestPreparedQuery() {
+    SearchServer search_server("and with"sv);
+    for (int id = 0; id < 20; ++id) {
+        search_server.AddDocument(id, "funny pet "s + std::to_string(id % 4) + " and nasty rat number "s + std::to_string(id),
+                                  DocumentStatus::ACTUAL, {id});
+    }
+    search_server.SetSynonyms(SynonymGraph(std::vector<std::pair<std::string_view, std::string_view>>{{"cat"sv, "pet"sv}}));
+
+    auto assert_same = [](const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+        }
+    };
+
+    const std::string raw_query = "funny cat 2 -3 num*"s;
+    SearchServer::PreparedQuery query = search_server.PrepareQuery(raw_query);
+    ASSERT_EQUAL(query.GetRawQuery(), raw_query);
+    assert_same(search_server.FindTopDocuments(query), search_server.FindTopDocuments(raw_query));
+    auto is_even = [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; };
+    assert_same(search_server.FindTopDocuments(query, is_even), search_server.FindTopDocuments(raw_query, is_even));
+
+    // слова смотрят в строку самого запроса -- перемещение их не портит
+    SearchServer::PreparedQuery moved = std::move(query);
+    assert_same(search_server.FindTopDocuments(moved), search_server.FindTopDocuments(raw_query));
+
+    // после изменения индекса запрос устарел, но результат по-прежнему верный
+    search_server.AddDocument(100, "funny pet 2"sv, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(2);
+    assert_same(search_server.FindTopDocuments(moved), search_server.FindTopDocuments(raw_query));
+    search_server.RefreshQuery(moved);
+    assert_same(search_server.FindTopDocuments(moved), search_server.FindTopDocuments(raw_query));
+
+    // запрос другого сервера для этого всегда устаревший
+    const SearchServer copy(search_server);
+    assert_same(copy.FindTopDocuments(moved), copy.FindTopDocuments(raw_query));
+
+    const auto [words, status] = search_server.MatchDocument(moved, 6);
+    const auto [expected_words, expected_status] = search_server.MatchDocument(raw_query, 6);
+    ASSERT_EQUAL(words, expected_words);
+    ASSERT_EQUAL(static_cast<int>(status), static_cast<int>(expected_status));
+    ASSERT(std::get<0>(search_server.MatchDocument(search_server.PrepareQuery("funny -pet"sv), 6)).empty());
+
+    try {
+        search_server.PrepareQuery("funny --pet"sv);
+        ASSERT_HINT(false, "Invalid query must throw"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestStopWordFilter() {
+    ASSERT(!StopWordFilter().Contains("and"sv));
+    ASSERT(!StopWordFilter().Contains(""sv));
+
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back("w"s + std::to_string(i * 7));
+    }
+    words.push_back("w0"s);
+    words.push_back(""s);
+
+    // фильтр хранит свою копию букв -- исходные строки ему не нужны
+    std::optional<StopWordFilter> filter;
+    {
+        const std::vector<std::string> temporary_words = words;
+        filter.emplace(temporary_words);
+    }
+    ASSERT_EQUAL(filter->GetWordCount(), 1000u);
+    for (int i = 0; i < 7000; ++i) {
+        // та же длина и первая буква, что у стоп-слов, -- не отсекаются предфильтром
+        ASSERT_EQUAL(filter->Contains("w"s + std::to_string(i)), i % 7 == 0);
+    }
+    ASSERT(!filter->Contains(""sv));
+    ASSERT(!filter->Contains("w"sv));
+    ASSERT(!filter->Contains("w00"sv));
+    ASSERT(!filter->Contains("x0"sv));
+
+    // большой словарь: в таблице ровно на число слов последним корзинам не находилось seed
+    {
+        std::vector<std::string> many_words;
+        for (int i = 0; i < 300000; ++i) {
+            many_words.push_back("s"s + std::to_string(i * 3));
+        }
+        const StopWordFilter large_filter(many_words);
+        ASSERT_EQUAL(large_filter.GetWordCount(), 300000u);
+        for (int i = 0; i < 900000; ++i) {
+            ASSERT_EQUAL(large_filter.Contains("s"s + std::to_string(i)), i % 3 == 0);
+        }
+    }
+
+    // стоп-слова из временной строки переживают ее
+    SearchServer search_server(std::string("and with"s));
+    search_server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {1});
+    ASSERT(search_server.FindTopDocuments("and"sv).empty());
+    ASSERT_EQUAL(search_server.GetWordFrequencies(1).size(), 4u);
+}
+
+void TestTermHashMap() {
+    using Postings = std::map<int, double, std::less<int>, CountingAllocator<std::pair<const int, double>>>;
+    const auto counter = std::make_shared<MemoryCounter>();
+    TermHashMap<Postings> term_map{Postings::allocator_type(counter)};
+    ASSERT(term_map.Find("cat"sv) == nullptr);
+    ASSERT_EQUAL(term_map.Erase("cat"sv), 0u);
+
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back("word"s + std::to_string(i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        term_map[words[i]][i] = i;
+    }
+    ASSERT_EQUAL(term_map.Size(), 1000u);
+    ASSERT(counter->Get() > 0);
+
+    // удаление сдвигает цепочки -- остальные слова должны находиться как прежде
+    for (int i = 0; i < 1000; i += 3) {
+        ASSERT_EQUAL(term_map.Erase(words[i]), 1u);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        const Postings* postings = term_map.Find(words[i]);
+        if (i % 3 == 0) {
+            ASSERT(postings == nullptr);
+        } else {
+            ASSERT(postings != nullptr);
+            ASSERT_EQUAL(postings->size(), 1u);
+            ASSERT_EQUAL(postings->begin()->first, i);
+        }
+    }
+
+    size_t visited = 0;
+    term_map.ForEach([&visited](std::string_view, const Postings&) { ++visited; });
+    ASSERT_EQUAL(visited, term_map.Size());
+
+    term_map.Clear();
+    ASSERT_EQUAL(term_map.Size(), 0u);
+    ASSERT_EQUAL(counter->Get(), 0u);
+}
+
+void TestRemoveDocuments() {
+    auto fill = [](SearchServer& search_server) {
+        search_server.EnablePositionalIndex();
+        for (int id = 0; id < 40; ++id) {
+            search_server.AddDocument(id, "funny pet "s + std::to_string(id % 4) + " and nasty rat "s + std::to_string(id),
+                                      id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id});
+        }
+    };
+
+    SearchServer search_server("and with"sv);
+    fill(search_server);
+    SearchServer expected("and with"sv);
+    fill(expected);
+
+    const std::vector<int> removed = {3, 7, 10, 10, 1000};
+    search_server.RemoveDocuments(removed);
+    for (const int document_id : removed) {
+        expected.RemoveDocument(document_id);
+    }
+    ASSERT_EQUAL(search_server.GetUnpurgedDocumentCount(), 3);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 37);
+
+    // удаленные документы не видны сразу, даже фильтру без статусов
+    auto any_document = [](int, DocumentStatus, int) { return true; };
+    auto ids = [](const std::vector<Document>& documents) {
+        std::set<int> result;
+        for (const Document& document : documents) {
+            result.insert(document.id);
+        }
+        return result;
+    };
+    for (const std::string& query : {"rat 3"s, "rat 10"s, "\"pet 3\""s, "nasty -2"s}) {
+        ASSERT_EQUAL(ids(search_server.FindTopDocuments(query, any_document)), ids(expected.FindTopDocuments(query, any_document)));
+        ASSERT_EQUAL(ids(search_server.FindTopDocuments(std::execution::par, query, any_document)), ids(expected.FindTopDocuments(query, any_document)));
+    }
+    ASSERT(search_server.FindTopDocuments("7"sv, any_document).empty());
+    try {
+        search_server.MatchDocument("rat"sv, 7);
+        ASSERT_HINT(false, "Removed document must not match"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    // до чистки удаленные документы входят и в df, и в число документов: слово из всех документов
+    // не набирает релевантности, как и при удалении по одному, и порядок выдачи тот же
+    {
+        SearchServer lazy("and with"sv);
+        SearchServer eager("and with"sv);
+        for (int id = 0; id < 100; ++id) {
+            const std::string text = "common "s + (id == 50 ? "rare"s : "word"s + std::to_string(id % 7));
+            lazy.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+            eager.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        }
+        std::vector<int> batch;
+        for (int id = 0; id < 15; ++id) {
+            batch.push_back(id);
+            eager.RemoveDocument(id);
+        }
+        lazy.RemoveDocuments(batch);
+        ASSERT_EQUAL(lazy.GetUnpurgedDocumentCount(), 15);
+
+        // копия переносит надгробия и ранжирует так же, как оригинал
+        const SearchServer replica(lazy);
+        ASSERT_EQUAL(replica.GetUnpurgedDocumentCount(), 15);
+        ASSERT_EQUAL(replica.GetDocumentCount(), 85);
+        for (const std::string_view query : {"common rare"sv, "word3 word5"sv}) {
+            const std::vector<Document> lhs = lazy.FindTopDocuments(query);
+            const std::vector<Document> rhs = replica.FindTopDocuments(query);
+            ASSERT_EQUAL(lhs.size(), rhs.size());
+            for (size_t i = 0; i < lhs.size(); ++i) {
+                ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+                ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+            }
+        }
+        for (const Document& document : lazy.FindTopDocuments("common"sv)) {
+            ASSERT(std::abs(document.relevance) < 1e-9);
+        }
+        for (const std::string_view query : {"common rare"sv, "word3 word5"sv, "common word1 -word2"sv}) {
+            const std::vector<Document> lhs = lazy.FindTopDocuments(query);
+            const std::vector<Document> par_lhs = lazy.FindTopDocuments(std::execution::par, query);
+            const std::vector<Document> rhs = eager.FindTopDocuments(query);
+            ASSERT_EQUAL(lhs.size(), rhs.size());
+            ASSERT_EQUAL(par_lhs.size(), rhs.size());
+            for (size_t i = 0; i < lhs.size(); ++i) {
+                ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+                ASSERT_EQUAL(par_lhs[i].id, rhs[i].id);
+                ASSERT(lhs[i].relevance >= 0.0);
+                ASSERT(std::abs(par_lhs[i].relevance - lhs[i].relevance) < 1e-9);
+            }
+        }
+    }
+
+    // после чистки индекс совпадает с удаленным по одному, вплоть до релевантности
+    search_server.PurgeRemovedDocuments();
+    ASSERT_EQUAL(search_server.GetUnpurgedDocumentCount(), 0);
+    for (const std::string& query : {"rat 3"s, "funny pet"s, "\"nasty rat\""s}) {
+        const std::vector<Document> lhs = search_server.FindTopDocuments(query, any_document);
+        const std::vector<Document> rhs = expected.FindTopDocuments(query, any_document);
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+        }
+    }
+
+    // большая пачка чистится сама; освободившийся id можно занять снова
+    std::vector<int> batch;
+    for (int id = 20; id < 40; ++id) {
+        batch.push_back(id);
+    }
+    search_server.RemoveDocuments(batch);
+    ASSERT_EQUAL(search_server.GetUnpurgedDocumentCount(), 0);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 17);
+    ASSERT(search_server.FindTopDocuments("25"sv).empty());
+    search_server.AddDocument(25, "rat"sv, DocumentStatus::ACTUAL, {1});
+    ASSERT(search_server.FindTopDocuments("25"sv).empty());
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 18);
+
+    search_server.RemoveDocuments({0});
+    ASSERT_EQUAL(search_server.GetUnpurgedDocumentCount(), 1);
+    search_server.Compact();
+    ASSERT_EQUAL(search_server.GetUnpurgedDocumentCount(), 0);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 17);
+}
+
+void TestUpdateDocument() {
+    auto fill = [](SearchServer& search_server, std::string_view text_of_7) {
+        search_server.EnablePositionalIndex();
+        for (int id = 0; id < 10; ++id) {
+            const std::string text = "funny pet "s + std::to_string(id % 3) + " and nasty rat "s + std::to_string(id);
+            search_server.AddDocument(id, id == 7 ? std::string(text_of_7) : text, DocumentStatus::ACTUAL, {id});
+        }
+    };
+
+    const std::string new_text = "nasty nasty dog with curly tail"s;
+    SearchServer search_server("and with"sv);
+    fill(search_server, "funny pet 1 and nasty rat 7"sv);
+    search_server.UpdateDocument(7, new_text);
+    SearchServer expected("and with"sv);
+    fill(expected, new_text);
+
+    // после правки индекс совпадает с индексом, в который документ сразу добавлен с новым текстом
+    for (const std::string& query : {"nasty dog"s, "rat 7"s, "funny pet -tail"s, "\"curly tail\""s, "\"nasty rat\""s}) {
+        const std::vector<Document> lhs = search_server.FindTopDocuments(query);
+        const std::vector<Document> rhs = expected.FindTopDocuments(query);
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+        }
+    }
+    ASSERT(std::get<0>(search_server.MatchDocument("rat 7 funny"sv, 7)).empty());
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("dog rat"sv, 7)).size(), 1u);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 10);
+
+    // атрибуты меняются без переиндексации
+    search_server.UpdateDocumentAttributes(7, DocumentStatus::BANNED, {42});
+    ASSERT(search_server.FindTopDocuments("dog"sv).empty());
+    const std::vector<Document> banned = search_server.FindTopDocuments("dog"sv, DocumentStatus::BANNED);
+    ASSERT_EQUAL(banned.size(), 1u);
+    ASSERT_EQUAL(banned[0].id, 7);
+    ASSERT_EQUAL(banned[0].rating, 42);
+    ASSERT(std::get<1>(search_server.MatchDocument("dog"sv, 7)) == DocumentStatus::BANNED);
+
+    try {
+        search_server.UpdateDocument(100, "dog"sv);
+        ASSERT_HINT(false, "Nonexistent document must not be updated"s);
+    } catch (const std::invalid_argument&) {
+    }
+    try {
+        search_server.UpdateDocumentAttributes(-1, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Negative document id must not be updated"s);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+void TestDocumentIdMap() {
+    const auto counter = std::make_shared<MemoryCounter>();
+    DocumentIdMap id_map{DocumentIdMap::Allocator(counter)};
+    ASSERT_EQUAL(id_map.Find(5), DocumentIdMap::NOT_FOUND);
+    ASSERT_EQUAL(id_map.Erase(5), 0u);
+
+    // редкие большие id вперемешку с подряд идущими
+    for (int i = 0; i < 1000; ++i) {
+        id_map.Insert(i % 2 == 0 ? i : i * 1000003, i);
+    }
+    ASSERT_EQUAL(id_map.Size(), 1000u);
+    ASSERT(counter->Get() > 0);
+    for (int i = 0; i < 1000; i += 3) {
+        ASSERT_EQUAL(id_map.Erase(i % 2 == 0 ? i : i * 1000003), 1u);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQUAL(id_map.Find(i % 2 == 0 ? i : i * 1000003), i % 3 == 0 ? DocumentIdMap::NOT_FOUND : i);
+    }
+    id_map.Clear();
+    ASSERT_EQUAL(id_map.Size(), 0u);
+    ASSERT_EQUAL(counter->Get(), 0u);
+
+    // id сервера идут подряд и по возрастанию при любом порядке добавления и удаления
+    SearchServer search_server("and with"sv);
+    for (const int document_id : {30, 10, 1000000, 20, 5}) {
+        search_server.AddDocument(document_id, "rat "s + std::to_string(document_id), DocumentStatus::ACTUAL, {1});
+    }
+    search_server.RemoveDocument(20);
+    search_server.RemoveDocuments({5, 30});
+    search_server.AddDocument(20, "rat again"sv, DocumentStatus::ACTUAL, {2});
+    ASSERT_EQUAL(std::vector<int>(search_server.begin(), search_server.end()), (std::vector<int>{10, 20, 1000000}));
+    ASSERT_EQUAL(search_server.GetWordFrequencies(20).count("again"sv), 1u);
+    ASSERT(search_server.GetWordFrequencies(30).empty());
+
+    // Compact перенумеровывает внутренние id подряд, внешние не меняются
+    search_server.Compact();
+    ASSERT_EQUAL(std::vector<int>(search_server.begin(), search_server.end()), (std::vector<int>{10, 20, 1000000}));
+    ASSERT_EQUAL(search_server.FindTopDocuments("again"sv).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("again"sv)[0].id, 20);
+    ASSERT_EQUAL(search_server.FindTopDocuments("1000000"sv)[0].id, 1000000);
+
+    // удаление внутри обхода не портит обходимый снимок; следующий обход видит новый набор
+    for (int document_id = 100; document_id > 50; --document_id) {
+        search_server.AddDocument(document_id, "cat"sv, DocumentStatus::ACTUAL, {1});
+    }
+    for (const int document_id : search_server) {
+        if (document_id % 2 == 1 || document_id == 1000000) {
+            search_server.RemoveDocument(document_id);
+        }
+    }
+    std::vector<int> expected_ids = {10, 20};
+    for (int document_id = 52; document_id <= 100; document_id += 2) {
+        expected_ids.push_back(document_id);
+    }
+    ASSERT_EQUAL(std::vector<int>(search_server.begin(), search_server.end()), expected_ids);
+}
+
+void TestRequestQueueStatistics() {
+    using namespace std::chrono;
+
+    SearchServer search_server("and with"sv);
+    search_server.AddDocument(1, "funny pet and nasty rat"sv, DocumentStatus::ACTUAL, {7, 2, 7});
+
+    {
+        RequestQueue request_queue(search_server);
+        const RequestQueue::Clock::time_point now = RequestQueue::Clock::now();
+
+        // два часа назад: пустой запрос; полчаса назад: непустой; последние 10 секунд: один пустой и два непустых
+        request_queue.RecordRequest(0, microseconds(10), now - hours(2));
+        request_queue.RecordRequest(3, microseconds(20), now - minutes(30));
+        request_queue.RecordRequest(0, microseconds(30), now - seconds(10));
+        request_queue.RecordRequest(1, microseconds(40), now - seconds(5));
+        request_queue.RecordRequest(2, microseconds(50), now - seconds(1));
+
+        const RequestStatistics last_minute = request_queue.GetStatistics(minutes(1), now);
+        ASSERT_EQUAL(last_minute.requests, 3u);
+        ASSERT_EQUAL(last_minute.empty_results, 1u);
+        ASSERT(std::abs(last_minute.queries_per_second - 3.0 / 60) < 1e-9);
+        ASSERT_EQUAL(last_minute.latency_p50_ns, 40'000u);
+        ASSERT_EQUAL(last_minute.latency_max_ns, 50'000u);
+        ASSERT(!last_minute.is_window_truncated);
+
+        ASSERT_EQUAL(request_queue.GetStatistics(hours(1), now).requests, 4u);
+        ASSERT_EQUAL(request_queue.GetStatistics(hours(24), now).empty_results, 2u);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 2);
+    }
+
+    {
+        // долгий запрос начался до окна, но закончился последним -- он не заслоняет записи перед ним
+        RequestQueue request_queue(search_server);
+        const RequestQueue::Clock::time_point now = RequestQueue::Clock::now();
+        request_queue.RecordRequest(1, milliseconds(1), now - seconds(3));
+        request_queue.RecordRequest(1, milliseconds(1), now - milliseconds(500));
+        request_queue.RecordRequest(0, milliseconds(1), now - milliseconds(400));
+        request_queue.RecordRequest(2, seconds(2), now - seconds(2));
+
+        const RequestStatistics last_second = request_queue.GetStatistics(seconds(1), now);
+        ASSERT_EQUAL(last_second.requests, 3u);
+        ASSERT_EQUAL(last_second.empty_results, 1u);
+        ASSERT_EQUAL(last_second.latency_max_ns, 2'000'000'000u);
+    }
+
+    {
+        // параллельный писатель замерил время раньше, а номер взял позже: его запись чуть раньше окна
+        // лежит между записями из окна и не обрывает просмотр
+        RequestQueue request_queue(search_server);
+        const RequestQueue::Clock::time_point now = RequestQueue::Clock::now();
+        request_queue.RecordRequest(1, microseconds(10), now - milliseconds(900));
+        request_queue.RecordRequest(0, microseconds(10), now - milliseconds(1100));
+        request_queue.RecordRequest(2, microseconds(10), now - milliseconds(100));
+
+        const RequestStatistics last_second = request_queue.GetStatistics(seconds(1), now);
+        ASSERT_EQUAL(last_second.requests, 2u);
+        ASSERT_EQUAL(last_second.empty_results, 0u);
+    }
+
+    {
+        // буфер на 4 запроса: старые вытесняются, окно честно помечается неполным
+        RequestQueue request_queue(search_server, 4);
+        for (int i = 0; i < 6; ++i) {
+            request_queue.AddFindRequest("nasty"sv);
+        }
+        request_queue.AddFindRequest("unknown"sv);
+
+        const RequestStatistics statistics = request_queue.GetStatistics(hours(1));
+        ASSERT_EQUAL(statistics.requests, 4u);
+        ASSERT_EQUAL(statistics.empty_results, 1u);
+        ASSERT(statistics.is_window_truncated);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 1);
+    }
+
+    {
+        RequestQueue request_queue(search_server);
+        const int thread_count = 4;
+        const int requests_per_thread = 250;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&request_queue, t] {
+                for (int i = 0; i < requests_per_thread; ++i) {
+                    request_queue.AddFindRequest(t % 2 == 0 ? "funny"sv : "empty"sv);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        const RequestStatistics statistics = request_queue.GetStatistics(hours(1));
+        ASSERT_EQUAL(statistics.requests, static_cast<uint64_t>(thread_count * requests_per_thread));
+        ASSERT_EQUAL(statistics.empty_results, static_cast<uint64_t>(thread_count * requests_per_thread / 2));
+    }
+}
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer() {
     RUN_TEST(TestGetWordFrequencies);
     RUN_TEST(TestRemoveDocument);
     RUN_TEST(TestRemoveDuplicates);
+    RUN_TEST(TestRemoveNearDuplicates);
+    RUN_TEST(TestLatencyHistogram);
+    RUN_TEST(TestTraceSnapshot);
+    RUN_TEST(TestQueryStats);
+    RUN_TEST(TestRequestQueueStatistics);
+    RUN_TEST(TestSearchAfterCursor);
+    RUN_TEST(TestPaginator);
+    RUN_TEST(TestPhraseQuery);
+    RUN_TEST(TestWildcardQuery);
+    RUN_TEST(TestFuzzyQuery);
+    RUN_TEST(TestSynonymExpansion);
+    RUN_TEST(TestBm25Ranking);
+    RUN_TEST(TestQueryDeadline);
+    RUN_TEST(TestProcessQueriesAdmission);
+    RUN_TEST(TestNumaExecutor);
+    RUN_TEST(TestMemoryUsage);
+    RUN_TEST(TestMemoryResource);
+    RUN_TEST(TestScratchArena);
+    RUN_TEST(TestPreparedQuery);
+    RUN_TEST(TestStopWordFilter);
+    RUN_TEST(TestTermHashMap);
+    RUN_TEST(TestRemoveDocuments);
+    RUN_TEST(TestUpdateDocument);
+    RUN_TEST(TestDocumentIdMap);
     RUN_TEST(TestAddingDocuments);
     RUN_TEST(TestExcludingStopWords);
     RUN_TEST(TestExcludingMinusWords);
@@ -322,5 +2037,7 @@ void TestSearchServer() {
     RUN_TEST(TestCalculateRating);
     RUN_TEST(TestPredicateAsFilter);
     RUN_TEST(TestGivenStatusAsFilter);
+    RUN_TEST(TestStatusFilterAfterRemove);
+    RUN_TEST(TestDocumentFilterExpression);
     RUN_TEST(TestIsCorrectRelevance);
 }
\ No newline at end of file
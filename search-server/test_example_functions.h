@@ -5,6 +5,11 @@
 #include <tuple>
 #include <utility>
 #include "search_server.h"
+#include "near_duplicates.h"
+#include "request_queue.h"
+#include "process_queries.h"
+#include "numa_executor.h"
+#include "trace.h"
 
 using namespace std::literals;
 
@@ -31,8 +36,8 @@ void PrintContainer(std::ostream& output, const ContainerType& container) {
     }
 }
 
-template<typename K, typename V>
-std::ostream& operator<<(std::ostream& output, const std::map<K, V>& m) {
+template<typename K, typename V, typename Compare, typename Allocator>
+std::ostream& operator<<(std::ostream& output, const std::map<K, V, Compare, Allocator>& m) {
 
     output << '{';
     PrintContainer(output, m);
@@ -116,6 +121,10 @@ void TestPredicateAsFilter();
 
 void TestGivenStatusAsFilter();
 
+void TestStatusFilterAfterRemove();
+
+void TestDocumentFilterExpression();
+
 void TestIsCorrectRelevance();
 
 void TestGetWordFrequencies();
@@ -124,6 +133,35 @@ void TestRemoveDocument();
 
 void TestRemoveDuplicates();
 
+void TestRemoveNearDuplicates();
+
+void TestLatencyHistogram();
+
+void TestTraceSnapshot();
+
+void TestQueryStats();
+
+void TestRequestQueueStatistics();
+void TestSearchAfterCursor();
+void TestPaginator();
+void TestPhraseQuery();
+void TestWildcardQuery();
+void TestFuzzyQuery();
+void TestSynonymExpansion();
+void TestBm25Ranking();
+void TestQueryDeadline();
+void TestProcessQueriesAdmission();
+void TestNumaExecutor();
+void TestMemoryUsage();
+void TestMemoryResource();
+void TestScratchArena();
+void TestPreparedQuery();
+void TestStopWordFilter();
+void TestTermHashMap();
+void TestRemoveDocuments();
+void TestUpdateDocument();
+void TestDocumentIdMap();
+
 // Функция TestSearchServer является точкой входа для запуска тестов
 void TestSearchServer();
 
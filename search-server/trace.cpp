@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include "trace.h"
+
+using namespace std::literals;
+
+namespace {
+
+struct ThreadHistograms {
+    std::array<LatencyHistogram, TRACE_SPAN_COUNT> spans;
+};
+
+// реестр гистограмм живых потоков и итог завершившихся; мьютекс берется только при первой записи потока,
+// при его завершении и при снимке
+struct TraceRegistry {
+    std::mutex guard;
+    std::vector<ThreadHistograms*> threads;
+    ThreadHistograms retired; // пишется только под guard
+};
+
+TraceRegistry& GetRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+// гистограммы потока; при завершении потока сливаются в итог реестра, чтобы записи не терялись
+class ThreadHistogramsOwner {
+public:
+    ThreadHistogramsOwner() : histograms_(std::make_unique<ThreadHistograms>()) {
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard guard(registry.guard);
+        registry.threads.push_back(histograms_.get());
+    }
+
+    ThreadHistogramsOwner(const ThreadHistogramsOwner&) = delete;
+    ThreadHistogramsOwner& operator=(const ThreadHistogramsOwner&) = delete;
+
+    // thread_local объекты главного потока разрушаются раньше статических, так что реестр еще жив
+    ~ThreadHistogramsOwner() {
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard guard(registry.guard);
+        for (int span = 0; span < TRACE_SPAN_COUNT; ++span) {
+            registry.retired.spans[span].Merge(histograms_->spans[span]);
+        }
+        registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), histograms_.get()));
+    }
+
+    ThreadHistograms& Get() {
+        return *histograms_;
+    }
+
+private:
+    std::unique_ptr<ThreadHistograms> histograms_;
+};
+
+ThreadHistograms& GetThreadHistograms() {
+    thread_local ThreadHistogramsOwner owner;
+    return owner.Get();
+}
+
+uint64_t GetPercentile(const std::vector<uint64_t>& counts, uint64_t total, double quantile, uint64_t max_ns) {
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * total + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // верхняя граница корзины, но не больше реально встреченного максимума
+            const uint64_t upper_bound = i + 1 < LatencyHistogram::BUCKET_COUNT
+                                         ? LatencyHistogram::GetBucketLowerBound(i + 1) - 1
+                                         : max_ns;
+            return std::min(upper_bound, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+} // namespace
+
+std::string_view GetTraceSpanName(TraceSpan span) {
+    switch (span) {
+        case TraceSpan::FIND_TOP_DOCUMENTS: return "find_top_documents"sv;
+        case TraceSpan::MATCH_DOCUMENT: return "match_document"sv;
+        case TraceSpan::PARSE: return "parse"sv;
+        case TraceSpan::SCORE: return "score"sv;
+        case TraceSpan::FILTER: return "filter"sv;
+        case TraceSpan::SORT: return "sort"sv;
+    }
+    return "unknown"sv;
+}
+
+int LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+
+    const int exponent = 63 - __builtin_clzll(value);
+    if (exponent > MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+
+    const int sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketLowerBound(int index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    const int exponent = index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    return (SUB_BUCKET_COUNT + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+}
+
+void LatencyHistogram::Record(uint64_t value_ns) {
+    // единственный писатель -- обходимся без read-modify-write, хватает relaxed загрузки и записи
+    std::atomic<uint64_t>& counter = counts_[GetBucketIndex(value_ns)];
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (value_ns > max_ns_.load(std::memory_order_relaxed)) {
+        max_ns_.store(value_ns, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::AddTo(std::vector<uint64_t>& counts, uint64_t& max_ns) const {
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] += counts_[i].load(std::memory_order_relaxed);
+    }
+    max_ns = std::max(max_ns, max_ns_.load(std::memory_order_relaxed));
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        counts_[i].store(counts_[i].load(std::memory_order_relaxed) + other.counts_[i].load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+    }
+    max_ns_.store(std::max(max_ns_.load(std::memory_order_relaxed), other.max_ns_.load(std::memory_order_relaxed)),
+                  std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& counter : counts_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+void SetTracingEnabled(bool is_enabled) {
+    tracing_enabled.store(is_enabled, std::memory_order_relaxed);
+}
+
+void RecordTrace(TraceSpan span, uint64_t duration_ns) {
+    GetThreadHistograms().spans[static_cast<int>(span)].Record(duration_ns);
+}
+
+std::vector<SpanStats> GetTraceSnapshot() {
+    std::vector<std::vector<uint64_t>> counts(TRACE_SPAN_COUNT, std::vector<uint64_t>(LatencyHistogram::BUCKET_COUNT));
+    std::vector<uint64_t> max_ns(TRACE_SPAN_COUNT);
+
+    {
+        TraceRegistry& registry = GetRegistry();
+        std::lock_guard guard(registry.guard);
+        for (int span = 0; span < TRACE_SPAN_COUNT; ++span) {
+            registry.retired.spans[span].AddTo(counts[span], max_ns[span]);
+        }
+        for (const ThreadHistograms* thread_histograms : registry.threads) {
+            for (int span = 0; span < TRACE_SPAN_COUNT; ++span) {
+                thread_histograms->spans[span].AddTo(counts[span], max_ns[span]);
+            }
+        }
+    }
+
+    std::vector<SpanStats> result;
+    for (int span = 0; span < TRACE_SPAN_COUNT; ++span) {
+        SpanStats stats;
+        stats.name = GetTraceSpanName(static_cast<TraceSpan>(span));
+        for (const uint64_t count : counts[span]) {
+            stats.count += count;
+        }
+        if (stats.count > 0) {
+            stats.p50_ns = GetPercentile(counts[span], stats.count, 0.5, max_ns[span]);
+            stats.p99_ns = GetPercentile(counts[span], stats.count, 0.99, max_ns[span]);
+            stats.p999_ns = GetPercentile(counts[span], stats.count, 0.999, max_ns[span]);
+            stats.max_ns = max_ns[span];
+        }
+        result.push_back(stats);
+    }
+
+    return result;
+}
+
+void ResetTraces() {
+    TraceRegistry& registry = GetRegistry();
+    std::lock_guard guard(registry.guard);
+    for (LatencyHistogram& histogram : registry.retired.spans) {
+        histogram.Reset();
+    }
+    for (ThreadHistograms* thread_histograms : registry.threads) {
+        for (LatencyHistogram& histogram : thread_histograms->spans) {
+            histogram.Reset();
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Трассировка фаз поиска с наносекундным разрешением.
+// Каждый поток пишет в свои гистограммы без блокировок; снимок собирает гистограммы всех потоков.
+// Завершившийся поток сливает свои гистограммы в общий итог и освобождает их, так что память не растет
+// от потоков, которые запускаются на каждый запрос.
+// Выключенная трассировка стоит одну встроенную relaxed-загрузку флага на спан.
+
+#define TRACE_CONCAT_INTERNAL(X, Y) X##Y
+#define TRACE_CONCAT(X, Y) TRACE_CONCAT_INTERNAL(X, Y)
+#define TRACE_SPAN(span) TraceScope TRACE_CONCAT(traceGuard, __LINE__)(span)
+
+enum class TraceSpan {
+    FIND_TOP_DOCUMENTS,
+    MATCH_DOCUMENT,
+    PARSE,
+    SCORE,
+    FILTER,
+    SORT,
+};
+
+const int TRACE_SPAN_COUNT = 6;
+
+std::string_view GetTraceSpanName(TraceSpan span);
+
+// HDR-подобная гистограмма: на каждую степень двойки по 2^SUB_BUCKET_BITS корзин,
+// так что относительная погрешность значения не больше 1/32
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const int MAX_EXPONENT = 40; // ~18 минут в наносекундах, дальше все попадает в последнюю корзину
+    static const int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKET_COUNT;
+
+    static int GetBucketIndex(uint64_t value);
+
+    static uint64_t GetBucketLowerBound(int index);
+
+    // писать может только поток-владелец, читать -- кто угодно
+    void Record(uint64_t value_ns);
+
+    // прибавляет показания этой гистограммы к counts
+    void AddTo(std::vector<uint64_t>& counts, uint64_t& max_ns) const;
+
+    // прибавляет показания other к этой гистограмме; как и Record, только для единственного писателя
+    void Merge(const LatencyHistogram& other);
+
+    void Reset();
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+struct SpanStats {
+    std::string_view name;
+    uint64_t count = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+// флаг читается в каждом спане, поэтому он виден в заголовке и проверка встраивается; менять -- через SetTracingEnabled
+inline std::atomic<bool> tracing_enabled{false};
+
+void SetTracingEnabled(bool is_enabled);
+
+inline bool IsTracingEnabled() {
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// сводка по всем спанам со всех потоков, включая уже завершившиеся
+std::vector<SpanStats> GetTraceSnapshot();
+
+// обнуляет гистограммы; записи, идущие параллельно со сбросом, могут частично сохраниться
+void ResetTraces();
+
+void RecordTrace(TraceSpan span, uint64_t duration_ns);
+
+class TraceScope {
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    explicit TraceScope(TraceSpan span) : span_(span), is_enabled_(IsTracingEnabled()) {
+        if (is_enabled_) {
+            start_time_ = Clock::now();
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope() {
+        if (is_enabled_) {
+            const auto duration = Clock::now() - start_time_;
+            RecordTrace(span_, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+        }
+    }
+
+private:
+    TraceSpan span_;
+    bool is_enabled_;
+    Clock::time_point start_time_;
+};